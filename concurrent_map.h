@@ -1,13 +1,24 @@
 #pragma once
+#include <deque>
+#include <map>
+#include <memory_resource>
 #include <mutex>
 using namespace std::string_literals;
 
 template <typename Key, typename Value>
 class ConcurrentMap {
 private:
+    // Узлы подсловаря выделяются из его собственного монотонного ресурса под мьютексом подсловаря;
+    // к общему ресурсу upstream подсловари обращаются только при росте, поэтому он должен быть потокобезопасным
     struct Minmap {
+        explicit Minmap(std::pmr::memory_resource* upstream)
+            : resource(upstream)
+            , map(&resource) {
+        }
+
         std::mutex mutex;
-        std::map<Key, Value> map;
+        std::pmr::monotonic_buffer_resource resource;
+        std::pmr::map<Key, Value> map;
     };
 
 public:
@@ -23,8 +34,12 @@ public:
         }
     };
  
-    explicit ConcurrentMap(size_t count_of_minmap)
-        : maps_(count_of_minmap) {
+    explicit ConcurrentMap(size_t count_of_minmap,
+                           std::pmr::memory_resource* upstream = std::pmr::get_default_resource())
+        : maps_(upstream) {
+        for (size_t i = 0; i < count_of_minmap; ++i) {
+            maps_.emplace_back(upstream);
+        }
     }
  
     Access operator[](const Key& key) {
@@ -32,15 +47,16 @@ public:
         return {key, map_};
     }
  
-    std::map<Key, Value> BuildOrdinaryMap() {
-        std::map<Key, Value> result_map;
-        for (auto& [mutex, map] : maps_) {
-            std::lock_guard g(mutex);
-            result_map.insert(map.begin(), map.end());
+    std::pmr::map<Key, Value> BuildOrdinaryMap(std::pmr::memory_resource* resource = std::pmr::get_default_resource()) {
+        std::pmr::map<Key, Value> result_map(resource);
+        for (auto& minmap : maps_) {
+            std::lock_guard g(minmap.mutex);
+            result_map.insert(minmap.map.begin(), minmap.map.end());
         }
         return result_map;
     }
  
 private:
-    std::vector<Minmap> maps_;
-};
\ No newline at end of file
+    // Подсловари тоже лежат в upstream, поэтому словарь не обращается к куче
+    std::pmr::deque<Minmap> maps_;
+};
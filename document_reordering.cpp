@@ -0,0 +1,154 @@
+#include "document_reordering.h"
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <execution>
+#include <limits>
+#include <numeric>
+#include <unordered_map>
+#include "string_processing.h"
+
+namespace {
+
+size_t GetVarintSize(uint64_t value) {
+    size_t size = 1;
+    while (value >= 0x80) {
+        value >>= 7;
+        ++size;
+    }
+    return size;
+}
+
+}  // namespace
+
+std::vector<int> ComputeSimilarityOrder(const SearchServer& search_server) {
+    using Signature = std::array<uint64_t, MINHASH_SIGNATURE_SIZE>;
+    const std::vector<int> document_ids(search_server.begin(), search_server.end());
+    std::vector<Signature> signatures(document_ids.size());
+    std::transform(std::execution::par, document_ids.begin(), document_ids.end(), signatures.begin(),
+                   [&search_server](int document_id) {
+                       Signature signature;
+                       signature.fill(std::numeric_limits<uint64_t>::max());
+                       for (const auto& [word, _] : search_server.GetWordFrequencies(document_id)) {
+                           for (size_t i = 0; i < MINHASH_SIGNATURE_SIZE; ++i) {
+                               signature[i] = std::min(signature[i], HashString(word, i));
+                           }
+                       }
+                       return signature;
+                   });
+
+    std::vector<size_t> order(document_ids.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(std::execution::par, order.begin(), order.end(), [&signatures, &document_ids](size_t lhs, size_t rhs) {
+        return std::tie(signatures[lhs], document_ids[lhs]) < std::tie(signatures[rhs], document_ids[rhs]);
+    });
+
+    std::vector<int> result(order.size());
+    std::transform(order.begin(), order.end(), result.begin(), [&document_ids](size_t index) {
+        return document_ids[index];
+    });
+    return result;
+}
+
+size_t ComputeCompressedPostingSize(const SearchServer& search_server) {
+    // Списки документов восстанавливаются по прямому индексу: документы обходятся по возрастанию id
+    std::vector<int> document_ids(search_server.begin(), search_server.end());
+    std::sort(document_ids.begin(), document_ids.end());
+    std::unordered_map<std::string_view, int> last_document_ids;
+    size_t size = 0;
+    for (const int document_id : document_ids) {
+        for (const auto& [word, _] : search_server.GetWordFrequencies(document_id)) {
+            const auto [last_iter, is_first] = last_document_ids.try_emplace(word, document_id);
+            const int previous_id = is_first ? 0 : last_iter->second;
+            size += GetVarintSize(static_cast<uint64_t>(document_id - previous_id));
+            last_iter->second = document_id;
+        }
+    }
+    return size;
+}
+
+ReorderedSearchServer::ReorderedSearchServer(const SearchServer& search_server)
+    : ReorderedSearchServer(search_server, ComputeSimilarityOrder(search_server)) {
+}
+
+ReorderedSearchServer::ReorderedSearchServer(const SearchServer& search_server, const std::vector<int>& document_order)
+    : ordinal_to_id_(document_order)
+    , search_server_(search_server.RenumberDocuments(document_order)) {
+    for (size_t i = 0; i < ordinal_to_id_.size(); ++i) {
+        id_to_ordinal_.emplace(ordinal_to_id_[i], static_cast<int>(i));
+    }
+}
+
+std::vector<Document> ReorderedSearchServer::FindTopDocuments(const std::string_view& raw_query,
+                                                              DocumentStatus status) const {
+    return FindTopDocuments(std::execution::seq, raw_query, status);
+}
+
+std::vector<Document> ReorderedSearchServer::FindTopDocuments(const std::string_view& raw_query) const {
+    return FindTopDocuments(std::execution::seq, raw_query);
+}
+
+std::tuple<std::vector<std::string_view>, DocumentStatus> ReorderedSearchServer::MatchDocument(
+    const std::string_view& raw_query,
+    int document_id) const {
+    return search_server_.MatchDocument(raw_query, GetOrdinal(document_id));
+}
+
+int ReorderedSearchServer::GetDocumentCount() const {
+    return search_server_.GetDocumentCount();
+}
+
+int ReorderedSearchServer::GetOrdinal(int document_id) const {
+    return id_to_ordinal_.at(document_id);
+}
+
+int ReorderedSearchServer::GetDocumentId(int ordinal) const {
+    return ordinal_to_id_.at(ordinal);
+}
+
+const SearchServer& ReorderedSearchServer::GetSearchServer() const {
+    return search_server_;
+}
+
+SearchServer& ReorderedSearchServer::GetSearchServer() {
+    return search_server_;
+}
+
+ReorderingReport MeasureReordering(const SearchServer& search_server, const ReorderedSearchServer& reordered,
+                                   const std::vector<std::string>& sample_queries) {
+    // Лучшее из нескольких прогонов, чтобы не учитывать прогрев кэшей
+    const auto measure = [&sample_queries](const auto& find) {
+        const int repeat_count = 3;
+        auto best_time = std::chrono::steady_clock::duration::max();
+        for (int i = 0; i < repeat_count; ++i) {
+            const auto start = std::chrono::steady_clock::now();
+            for (const std::string& raw_query : sample_queries) {
+                find(raw_query);
+            }
+            best_time = std::min(best_time, std::chrono::steady_clock::now() - start);
+        }
+        return std::chrono::duration<double, std::milli>(best_time).count() / std::max<size_t>(sample_queries.size(), 1);
+    };
+
+    // Исходный индекс тоже нумеруется подряд, в порядке добавления: иначе разница включала бы выигрыш
+    // от плотных номеров вместо редких внешних id, а не только от порядка сходства. Оба индекса ищут
+    // одним способом, с заменой номеров на внешние id
+    const std::vector<int> document_ids(search_server.begin(), search_server.end());
+    const SearchServer original = search_server.RenumberDocuments(document_ids);
+    ReorderingReport report;
+    report.posting_bytes_before = ComputeCompressedPostingSize(original);
+    report.posting_bytes_after = ComputeCompressedPostingSize(reordered.GetSearchServer());
+    report.query_time_before_ms = measure([&original, &document_ids](const std::string& raw_query) {
+        original.FindTopDocuments(
+            std::execution::seq, raw_query,
+            [](int document_id, DocumentStatus status, int rating) {
+                return status == DocumentStatus::ACTUAL;
+            },
+            document_ids);
+    });
+    report.query_time_after_ms = measure([&reordered](const std::string& raw_query) {
+        reordered.FindTopDocuments(std::execution::seq, raw_query);
+    });
+    return report;
+}
@@ -0,0 +1,111 @@
+#pragma once
+#include <map>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <vector>
+#include "search_server.h"
+#include "document.h"
+
+// Число хеш-функций MinHash, по значениям которых сортируются документы
+const size_t MINHASH_SIGNATURE_SIZE = 4;
+
+// Порядок документов, в котором документы с похожими наборами слов стоят рядом (MinHash-сортировка).
+// Для каждого документа вычисляются наименьшие хеши его слов по MINHASH_SIGNATURE_SIZE хеш-функциям;
+// у документов с общими словами они совпадают с вероятностью, равной коэффициенту Жаккара, поэтому
+// сортировка по ним сближает похожие документы. Возвращает id документов в новом порядке
+std::vector<int> ComputeSimilarityOrder(const SearchServer& search_server);
+
+// Объём списков документов в байтах, если хранить разности соседних id кодом переменной длины (varint)
+size_t ComputeCompressedPostingSize(const SearchServer& search_server);
+
+// Снимок индекса с документами, перенумерованными в порядке сходства: у списков документов частых слов
+// разности соседних номеров меньше, а поиск обходит накопители релевантности более локально.
+// Внешние id сохраняются: запросы и ответы используют их, а внутренние номера видны только через
+// GetSearchServer. Документы с равными релевантностью и рейтингом упорядочены по внешнему id, поэтому
+// выдача совпадает с исходным индексом. Снимок не меняется; после изменений исходного индекса его строят
+// заново. Контрольная точка WriteAheadLog с reorder_documents хранит документы в порядке сходства, и
+// ReorderedSearchServer(server, {server.begin(), server.end()}) для восстановленного из неё индекса
+// не вычисляет порядок повторно
+class ReorderedSearchServer {
+public:
+    explicit ReorderedSearchServer(const SearchServer& search_server);
+
+    // document_order — id документов в желаемом порядке внутренних номеров
+    ReorderedSearchServer(const SearchServer& search_server, const std::vector<int>& document_order);
+
+    template <typename ExecutionPolicy, typename DocumentPredicate>
+    std::vector<Document> FindTopDocuments(const ExecutionPolicy& policy, const std::string_view& raw_query,
+                                           DocumentPredicate document_predicate) const;
+
+    template <typename ExecutionPolicy>
+    std::vector<Document> FindTopDocuments(const ExecutionPolicy& policy, const std::string_view& raw_query,
+                                           DocumentStatus status) const;
+
+    template <typename ExecutionPolicy>
+    std::vector<Document> FindTopDocuments(const ExecutionPolicy& policy, const std::string_view& raw_query) const;
+
+    std::vector<Document> FindTopDocuments(const std::string_view& raw_query, DocumentStatus status) const;
+
+    std::vector<Document> FindTopDocuments(const std::string_view& raw_query) const;
+
+    std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(const std::string_view& raw_query,
+                                                                            int document_id) const;
+
+    int GetDocumentCount() const;
+
+    // Бросает std::out_of_range для неизвестного id
+    int GetOrdinal(int document_id) const;
+
+    int GetDocumentId(int ordinal) const;
+
+    // Индекс с внутренними номерами вместо id; через него меняются настройки поиска
+    const SearchServer& GetSearchServer() const;
+
+    SearchServer& GetSearchServer();
+
+private:
+    std::vector<int> ordinal_to_id_;
+    std::map<int, int> id_to_ordinal_;
+    SearchServer search_server_;
+};
+
+// Размер списков документов и время поиска до и после перенумерации. «До» — документы, пронумерованные
+// подряд в порядке добавления
+struct ReorderingReport {
+    size_t posting_bytes_before = 0;
+    size_t posting_bytes_after = 0;
+    // Среднее время последовательного FindTopDocuments на запрос, мс (лучшее из нескольких прогонов)
+    double query_time_before_ms = 0.0;
+    double query_time_after_ms = 0.0;
+};
+
+ReorderingReport MeasureReordering(const SearchServer& search_server, const ReorderedSearchServer& reordered,
+                                   const std::vector<std::string>& sample_queries);
+
+template <typename ExecutionPolicy, typename DocumentPredicate>
+std::vector<Document> ReorderedSearchServer::FindTopDocuments(const ExecutionPolicy& policy,
+                                                              const std::string_view& raw_query,
+                                                              DocumentPredicate document_predicate) const {
+    return search_server_.FindTopDocuments(
+        policy, raw_query,
+        [this, &document_predicate](int ordinal, DocumentStatus status, int rating) {
+            return document_predicate(ordinal_to_id_[ordinal], status, rating);
+        },
+        ordinal_to_id_);
+}
+
+template <typename ExecutionPolicy>
+std::vector<Document> ReorderedSearchServer::FindTopDocuments(const ExecutionPolicy& policy,
+                                                              const std::string_view& raw_query,
+                                                              DocumentStatus status) const {
+    return FindTopDocuments(policy, raw_query, [status](int document_id, DocumentStatus document_status, int rating) {
+        return document_status == status;
+    });
+}
+
+template <typename ExecutionPolicy>
+std::vector<Document> ReorderedSearchServer::FindTopDocuments(const ExecutionPolicy& policy,
+                                                              const std::string_view& raw_query) const {
+    return FindTopDocuments(policy, raw_query, DocumentStatus::ACTUAL);
+}
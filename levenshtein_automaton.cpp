@@ -0,0 +1,50 @@
+#include "levenshtein_automaton.h"
+
+LevenshteinAutomaton::LevenshteinAutomaton(const std::string_view& word, int max_distance,
+                                           std::pmr::memory_resource* resource)
+    : word_(word, resource)
+    , alphabet_(word, resource)
+    , max_distance_(max_distance) {
+    const auto is_less = [](char lhs, char rhs) {
+        return static_cast<unsigned char>(lhs) < static_cast<unsigned char>(rhs);
+    };
+    std::sort(alphabet_.begin(), alphabet_.end(), is_less);
+    alphabet_.erase(std::unique(alphabet_.begin(), alphabet_.end()), alphabet_.end());
+}
+
+int LevenshteinAutomaton::Step(const int* previous, int* next, char c) const {
+    // Значения больше max_distance_ не различаются, поэтому ограничены max_distance_ + 1
+    const int limit = max_distance_ + 1;
+    next[0] = std::min(previous[0] + 1, limit);
+    int row_min = next[0];
+    for (size_t i = 1; i <= word_.size(); ++i) {
+        const int substitution = previous[i - 1] + (word_[i - 1] == c ? 0 : 1);
+        next[i] = std::min({substitution, previous[i] + 1, next[i - 1] + 1, limit});
+        row_min = std::min(row_min, next[i]);
+    }
+    return row_min;
+}
+
+bool LevenshteinAutomaton::FindNextLiveChar(const int* previous, int* next, char after, char& result) const {
+    for (const char c : alphabet_) {
+        if (static_cast<unsigned char>(c) <= static_cast<unsigned char>(after)) {
+            continue;
+        }
+        if (Step(previous, next, c) <= max_distance_) {
+            result = c;
+            return true;
+        }
+    }
+    return false;
+}
+
+void LevenshteinAutomaton::GetPrefixSuccessor(const std::string_view& prefix, std::pmr::string& successor) {
+    successor.assign(prefix);
+    while (!successor.empty()) {
+        if (static_cast<unsigned char>(successor.back()) != 0xFF) {
+            ++successor.back();
+            return;
+        }
+        successor.pop_back();
+    }
+}
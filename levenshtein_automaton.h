@@ -0,0 +1,110 @@
+#pragma once
+#include <algorithm>
+#include <memory_resource>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Автомат Левенштейна для слова word: принимает слова на расстоянии редактирования не больше max_distance.
+// Состояние после чтения префикса — строка таблицы динамического программирования для этого префикса.
+// Если все значения строки больше max_distance, ни одно слово с таким префиксом не подходит.
+// Вся рабочая память берётся из resource (обычно арены запроса)
+class LevenshteinAutomaton {
+public:
+    LevenshteinAutomaton(const std::string_view& word, int max_distance,
+                         std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+
+    // Передаёт callback(term, distance) все подходящие слова упорядоченного словаря dictionary
+    // (ассоциативного контейнера с ключами std::string_view). Общие префиксы соседних слов
+    // вычисляются один раз, а поддеревья тупиковых префиксов пропускаются через lower_bound
+    template <typename SortedDictionary, typename Callback>
+    void ForEachMatch(const SortedDictionary& dictionary, Callback callback) const;
+
+private:
+    // Сколько слов словаря просматривается подряд, прежде чем пропуск выполняется через lower_bound
+    static constexpr int SKIP_SCAN_LIMIT = 8;
+
+    std::pmr::string word_;
+    // Различные символы word_ в порядке сравнения std::string_view
+    std::pmr::string alphabet_;
+    int max_distance_;
+
+    // Вычисляет строку next по строке previous после чтения символа c; возвращает минимум строки
+    int Step(const int* previous, int* next, char c) const;
+
+    // Ищет наименьший символ больше after, после которого строка previous не становится тупиковой.
+    // Символ, не входящий в слово, тупиковый, если тупиковый after, поэтому перебирается только alphabet_.
+    // Строка next используется как рабочая память
+    bool FindNextLiveChar(const int* previous, int* next, char after, char& result) const;
+
+    // Записывает в successor наименьшую строку, большую всех строк с префиксом prefix; пустую, если такой нет
+    static void GetPrefixSuccessor(const std::string_view& prefix, std::pmr::string& successor);
+};
+
+template <typename SortedDictionary, typename Callback>
+void LevenshteinAutomaton::ForEachMatch(const SortedDictionary& dictionary, Callback callback) const {
+    const size_t row_size = word_.size() + 1;
+    // Строка с номером depth — состояние после чтения depth первых символов предыдущего слова словаря
+    std::pmr::memory_resource* resource = word_.get_allocator().resource();
+    std::pmr::vector<int> rows(row_size, resource);
+    for (size_t i = 0; i < row_size; ++i) {
+        rows[i] = std::min(static_cast<int>(i), max_distance_ + 1);
+    }
+
+    std::string_view previous_term;
+    size_t depth = 0;
+    std::pmr::string skip_target(resource);
+    auto it = dictionary.begin();
+    while (it != dictionary.end()) {
+        const std::string_view term = it->first;
+        // Пустое слово (из документа с пустым словом) не считается совпадением ни на каком расстоянии
+        if (term.empty()) {
+            ++it;
+            continue;
+        }
+        const auto mismatch = std::mismatch(previous_term.begin(), previous_term.begin() + depth, term.begin(), term.end());
+        depth = mismatch.first - previous_term.begin();
+        previous_term = term;
+
+        bool is_dead = false;
+        while (depth < term.size()) {
+            rows.resize((depth + 2) * row_size);
+            const int row_min = Step(rows.data() + depth * row_size, rows.data() + (depth + 1) * row_size, term[depth]);
+            if (row_min > max_distance_) {
+                is_dead = true;
+                break;
+            }
+            ++depth;
+        }
+
+        if (!is_dead) {
+            const int distance = rows[depth * row_size + word_.size()];
+            if (distance <= max_distance_) {
+                callback(term, distance);
+            }
+            ++it;
+            continue;
+        }
+
+        // Префикс term[0, depth) живой, а с символом term[depth] — тупиковый: переходим к следующему
+        // живому символу, а если его нет, то за поддерево префикса
+        char next_char;
+        if (FindNextLiveChar(rows.data() + depth * row_size, rows.data() + (depth + 1) * row_size, term[depth], next_char)) {
+            skip_target.assign(term.substr(0, depth));
+            skip_target.push_back(next_char);
+        } else {
+            GetPrefixSuccessor(term.substr(0, depth), skip_target);
+            if (skip_target.empty()) {
+                break;
+            }
+        }
+        // Цель пропуска часто лежит в нескольких словах впереди: короткий линейный проход дешевле спуска по дереву
+        int step_count = 0;
+        for (++it; it != dictionary.end() && std::string_view(it->first) < skip_target; ++it) {
+            if (++step_count == SKIP_SCAN_LIMIT) {
+                it = dictionary.lower_bound(std::string_view(skip_target));
+                break;
+            }
+        }
+    }
+}
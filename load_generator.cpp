@@ -0,0 +1,264 @@
+// Нагрузочный клиент для search_daemon: держит несколько соединений, в каждом до --pipeline запросов
+// без ответа, и выводит пропускную способность и перцентили задержки
+#include <algorithm>
+#include <arpa/inet.h>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <random>
+#include <string>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <system_error>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+using namespace std;
+using Clock = chrono::steady_clock;
+
+namespace {
+
+struct LoadOptions {
+    string address = "127.0.0.1";
+    int port = -1;
+    string unix_socket_path;
+    size_t connection_count = 8;
+    size_t pipeline_depth = 16;
+    size_t request_count = 100000;
+    string requests_path;
+};
+
+struct ConnectionResult {
+    vector<double> latencies_us;
+    size_t error_count = 0;
+};
+
+int Connect(const LoadOptions& options) {
+    int file_descriptor = -1;
+    if (!options.unix_socket_path.empty()) {
+        sockaddr_un address{};
+        address.sun_family = AF_UNIX;
+        strncpy(address.sun_path, options.unix_socket_path.c_str(), sizeof(address.sun_path) - 1);
+        file_descriptor = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (file_descriptor >= 0 && connect(file_descriptor, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0) {
+            return file_descriptor;
+        }
+    } else {
+        sockaddr_in address{};
+        address.sin_family = AF_INET;
+        address.sin_port = htons(static_cast<uint16_t>(options.port));
+        inet_pton(AF_INET, options.address.c_str(), &address.sin_addr);
+        file_descriptor = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        const int enable = 1;
+        setsockopt(file_descriptor, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+        if (file_descriptor >= 0 && connect(file_descriptor, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0) {
+            return file_descriptor;
+        }
+    }
+    throw system_error(errno, generic_category(), "Cannot connect to search daemon");
+}
+
+void SendAll(int file_descriptor, const string& data) {
+    size_t sent = 0;
+    while (sent < data.size()) {
+        const ssize_t result = send(file_descriptor, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+        if (result < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw system_error(errno, generic_category(), "Send failed");
+        }
+        sent += result;
+    }
+}
+
+// Отправляет запросы requests[first], requests[first + step], ... и ждёт ответа на каждый
+ConnectionResult RunConnection(const LoadOptions& options, const vector<string>& requests, size_t first, size_t step,
+                               size_t request_count) {
+    ConnectionResult result;
+    result.latencies_us.reserve(request_count);
+    const int file_descriptor = Connect(options);
+
+    deque<Clock::time_point> send_times;
+    size_t sent_count = 0;
+    string input;
+    char buffer[64 * 1024];
+    while (result.latencies_us.size() < request_count) {
+        // Все запросы окна отправляются одним вызовом
+        string batch;
+        while (sent_count < request_count && send_times.size() < options.pipeline_depth) {
+            batch += requests[(first + sent_count * step) % requests.size()];
+            batch += '\n';
+            send_times.push_back(Clock::now());
+            ++sent_count;
+        }
+        if (!batch.empty()) {
+            SendAll(file_descriptor, batch);
+        }
+
+        const ssize_t read_size = recv(file_descriptor, buffer, sizeof(buffer), 0);
+        if (read_size <= 0) {
+            if (read_size < 0 && errno == EINTR) {
+                continue;
+            }
+            close(file_descriptor);
+            throw runtime_error("Connection closed by search daemon");
+        }
+        input.append(buffer, read_size);
+        const Clock::time_point now = Clock::now();
+        size_t line_begin = 0;
+        for (size_t line_end; (line_end = input.find('\n', line_begin)) != string::npos; line_begin = line_end + 1) {
+            if (input.compare(line_begin, 3, "ERR") == 0) {
+                ++result.error_count;
+            }
+            result.latencies_us.push_back(chrono::duration<double, micro>(now - send_times.front()).count());
+            send_times.pop_front();
+        }
+        input.erase(0, line_begin);
+    }
+    close(file_descriptor);
+    return result;
+}
+
+vector<string> LoadRequests(const LoadOptions& options) {
+    vector<string> requests;
+    if (!options.requests_path.empty()) {
+        ifstream input(options.requests_path);
+        if (!input) {
+            throw invalid_argument("Cannot read " + options.requests_path);
+        }
+        // Строка без команды считается поисковым запросом
+        for (string line; getline(input, line);) {
+            if (line.empty()) {
+                continue;
+            }
+            const string command = line.substr(0, line.find(' '));
+            const bool has_command = command == "FIND" || command == "MATCH" || command == "ADD" || command == "REMOVE"
+                                     || command == "STATUS" || command == "RATING";
+            requests.push_back(has_command ? line : "FIND " + line);
+        }
+        if (requests.empty()) {
+            throw invalid_argument("No requests in " + options.requests_path);
+        }
+        return requests;
+    }
+
+    const vector<string> words = {"white", "cat", "fluffy", "tail", "dog", "eyes", "groomed", "collar",
+                                  "curly", "nasty", "pigeon", "hat", "yellow", "big", "john", "fashion"};
+    mt19937 generator(42);
+    for (int i = 0; i < 1000; ++i) {
+        string request = "FIND";
+        const int word_count = 1 + generator() % 4;
+        for (int j = 0; j < word_count; ++j) {
+            request += ' ';
+            request += words[generator() % words.size()];
+        }
+        requests.push_back(move(request));
+    }
+    return requests;
+}
+
+void PrintUsage() {
+    cerr << "Usage: load_generator (--port N [--address A] | --unix PATH) [--connections N] [--pipeline N]\n"
+            "                      [--requests N] [--queries PATH]\n"
+            "--queries: one request per line; a line without a command is sent as FIND\n";
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    LoadOptions options;
+    try {
+        for (int i = 1; i < argc; ++i) {
+            const string argument = argv[i];
+            if (i + 1 == argc) {
+                throw invalid_argument("Missing value for " + argument);
+            }
+            const string value = argv[++i];
+            if (argument == "--port") {
+                options.port = stoi(value);
+            } else if (argument == "--address") {
+                options.address = value;
+            } else if (argument == "--unix") {
+                options.unix_socket_path = value;
+            } else if (argument == "--connections") {
+                options.connection_count = max<size_t>(stoul(value), 1);
+            } else if (argument == "--pipeline") {
+                options.pipeline_depth = max<size_t>(stoul(value), 1);
+            } else if (argument == "--requests") {
+                options.request_count = stoul(value);
+            } else if (argument == "--queries") {
+                options.requests_path = value;
+            } else {
+                throw invalid_argument("Unknown option " + argument);
+            }
+        }
+        if (options.port < 0 && options.unix_socket_path.empty()) {
+            throw invalid_argument("Specify --port or --unix");
+        }
+    } catch (const exception& error) {
+        cerr << error.what() << endl;
+        PrintUsage();
+        return 1;
+    }
+
+    try {
+        const vector<string> requests = LoadRequests(options);
+        vector<ConnectionResult> results(options.connection_count);
+        vector<exception_ptr> errors(options.connection_count);
+        vector<thread> threads;
+        const Clock::time_point start = Clock::now();
+        for (size_t i = 0; i < options.connection_count; ++i) {
+            const size_t request_count = options.request_count / options.connection_count
+                                       + (i < options.request_count % options.connection_count ? 1 : 0);
+            threads.emplace_back([&, i, request_count] {
+                try {
+                    results[i] = RunConnection(options, requests, i, options.connection_count, request_count);
+                } catch (...) {
+                    errors[i] = current_exception();
+                }
+            });
+        }
+        for (thread& worker : threads) {
+            worker.join();
+        }
+        const double seconds = chrono::duration<double>(Clock::now() - start).count();
+        for (const exception_ptr& error : errors) {
+            if (error) {
+                rethrow_exception(error);
+            }
+        }
+
+        vector<double> latencies;
+        size_t error_count = 0;
+        for (const ConnectionResult& result : results) {
+            latencies.insert(latencies.end(), result.latencies_us.begin(), result.latencies_us.end());
+            error_count += result.error_count;
+        }
+        sort(latencies.begin(), latencies.end());
+        const auto percentile = [&latencies](double share) {
+            if (latencies.empty()) {
+                return 0.0;
+            }
+            return latencies[min(latencies.size() - 1, static_cast<size_t>(share * latencies.size()))];
+        };
+
+        cout << fixed << setprecision(1);
+        cout << "requests: " << latencies.size() << ", errors: " << error_count << ", time: " << seconds << " s" << endl;
+        cout << "QPS: " << latencies.size() / seconds << endl;
+        cout << "latency us: p50 " << percentile(0.5) << ", p90 " << percentile(0.9) << ", p99 " << percentile(0.99)
+             << ", p99.9 " << percentile(0.999) << ", max " << (latencies.empty() ? 0.0 : latencies.back()) << endl;
+    } catch (const exception& error) {
+        cerr << error.what() << endl;
+        return 1;
+    }
+    return 0;
+}
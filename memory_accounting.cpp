@@ -0,0 +1,26 @@
+#include "memory_accounting.h"
+#include <algorithm>
+
+size_t GetMallocChunkSize(size_t size) {
+    // glibc добавляет к запросу заголовок размером в слово и выравнивает блок по 16 байт, минимум 32 байта
+    const size_t header_size = sizeof(size_t);
+    const size_t alignment = 16;
+    const size_t min_chunk_size = 32;
+    return std::max(min_chunk_size, (size + header_size + alignment - 1) & ~(alignment - 1));
+}
+
+void MemoryCounter::Allocate(size_t size) {
+    bytes += size;
+    overhead_bytes += GetMallocChunkSize(size) - size;
+    ++allocations;
+}
+
+void MemoryCounter::Deallocate(size_t size) {
+    bytes -= size;
+    overhead_bytes -= GetMallocChunkSize(size) - size;
+    --allocations;
+}
+
+size_t MemoryStats::GetTotalBytes() const {
+    return dictionary_bytes + posting_bytes + forward_index_bytes + document_metadata_bytes + allocator_overhead_bytes;
+}
@@ -0,0 +1,93 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <type_traits>
+
+// Размер блока, который glibc malloc выделяет под запрос size байт (с заголовком и выравниванием).
+// Модель 64-битного glibc; другие аллокаторы дают другие накладные расходы
+size_t GetMallocChunkSize(size_t size);
+
+// Счётчик памяти одной структуры индекса
+struct MemoryCounter {
+    std::atomic<size_t> bytes{0};
+    std::atomic<size_t> overhead_bytes{0};
+    std::atomic<size_t> allocations{0};
+
+    void Allocate(size_t size);
+
+    void Deallocate(size_t size);
+};
+
+// Аллокатор, учитывающий выделенную память в MemoryCounter. Без счётчика работает как std::allocator
+template <typename T>
+class CountingAllocator {
+public:
+    using value_type = T;
+    using propagate_on_container_move_assignment = std::true_type;
+    using propagate_on_container_swap = std::true_type;
+
+    CountingAllocator() noexcept = default;
+
+    explicit CountingAllocator(MemoryCounter* counter) noexcept
+        : counter_(counter) {
+    }
+
+    template <typename U>
+    CountingAllocator(const CountingAllocator<U>& other) noexcept
+        : counter_(other.GetCounter()) {
+    }
+
+    T* allocate(size_t n) {
+        T* result = std::allocator<T>{}.allocate(n);
+        if (counter_ != nullptr) {
+            counter_->Allocate(n * sizeof(T));
+        }
+        return result;
+    }
+
+    void deallocate(T* p, size_t n) noexcept {
+        std::allocator<T>{}.deallocate(p, n);
+        if (counter_ != nullptr) {
+            counter_->Deallocate(n * sizeof(T));
+        }
+    }
+
+    MemoryCounter* GetCounter() const noexcept {
+        return counter_;
+    }
+
+    template <typename U>
+    bool operator==(const CountingAllocator<U>& other) const noexcept {
+        return counter_ == other.GetCounter();
+    }
+
+    template <typename U>
+    bool operator!=(const CountingAllocator<U>& other) const noexcept {
+        return !(*this == other);
+    }
+
+private:
+    MemoryCounter* counter_ = nullptr;
+};
+
+// Размер одного узла контейнера, измеренный на контейнере из одного элемента.
+// Узел не зависит от аллокатора, поэтому размер подходит и для контейнера с std::allocator
+template <typename Container>
+size_t MeasureNodeSize() {
+    MemoryCounter counter;
+    Container probe((typename Container::allocator_type(&counter)));
+    probe.emplace();
+    return counter.bytes;
+}
+
+struct MemoryStats {
+    size_t dictionary_bytes = 0;         // строки словаря и узлы деревьев, упорядочивающих слова
+    size_t posting_bytes = 0;            // списки документов каждого слова
+    size_t forward_index_bytes = 0;      // частоты слов каждого документа
+    size_t document_metadata_bytes = 0;  // рейтинги, статусы и список id документов
+    size_t allocator_overhead_bytes = 0; // заголовки и выравнивание блоков malloc, оценка GetMallocChunkSize
+    size_t allocation_count = 0;
+
+    size_t GetTotalBytes() const;
+};
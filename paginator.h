@@ -3,6 +3,8 @@
 #include <vector>
 #include <iterator>
 #include <algorithm>
+#include <stdexcept>
+#include <type_traits>
 
 template <typename Iterator>
 class IteratorRange {
@@ -38,37 +40,104 @@ std::ostream& operator<<(std::ostream& out, const IteratorRange<Iterator>& range
     return out;
 }
 
+// Итератор по страницам: границы очередной страницы вычисляются только при переходе к ней.
+// Разыменование возвращает страницу по значению, поэтому итератор только входной
+template <typename Iterator>
+class PageIterator {
+public:
+    using iterator_category = std::input_iterator_tag;
+    using value_type = IteratorRange<Iterator>;
+    using difference_type = std::ptrdiff_t;
+    using pointer = void;
+    using reference = value_type;
+
+    PageIterator(Iterator begin, Iterator end, size_t page_size)
+        : page_begin_(begin)
+        , end_(end)
+        , page_size_(page_size)
+        , page_end_(NextPageEnd(begin)) {
+    }
+
+    reference operator*() const {
+        return {page_begin_, page_end_};
+    }
+
+    PageIterator& operator++() {
+        page_begin_ = page_end_;
+        page_end_ = NextPageEnd(page_begin_);
+        return *this;
+    }
+
+    PageIterator operator++(int) {
+        PageIterator previous = *this;
+        ++*this;
+        return previous;
+    }
+
+    bool operator==(const PageIterator& other) const {
+        return page_begin_ == other.page_begin_;
+    }
+
+    bool operator!=(const PageIterator& other) const {
+        return !(*this == other);
+    }
+
+private:
+    Iterator page_begin_;
+    Iterator end_;
+    size_t page_size_;
+    Iterator page_end_;
+
+    Iterator NextPageEnd(Iterator it) const {
+        using Category = typename std::iterator_traits<Iterator>::iterator_category;
+        if constexpr (std::is_base_of_v<std::random_access_iterator_tag, Category>) {
+            return std::next(it, std::min<size_t>(page_size_, std::distance(it, end_)));
+        } else {
+            for (size_t i = 0; i < page_size_ && it != end_; ++i) {
+                ++it;
+            }
+            return it;
+        }
+    }
+};
+
 template <typename Iterator>
 class Paginator {
 public:
-    Paginator(Iterator begin, Iterator end, size_t page_size) {
-        for (size_t left = distance(begin, end); left > 0;) {
-            const size_t current_page_size = std::min(page_size, left);
-            const Iterator current_page_end = next(begin, current_page_size);
-            pages_.push_back({begin, current_page_end});
-
-            left -= current_page_size;
-            begin = current_page_end;
+    Paginator(Iterator begin, Iterator end, size_t page_size)
+        : begin_(begin)
+        , end_(end)
+        , page_size_(page_size) {
+        if (page_size_ == 0) {
+            throw std::invalid_argument("Page size must be positive");
         }
     }
 
     auto begin() const {
-        return pages_.begin();
+        return PageIterator<Iterator>(begin_, end_, page_size_);
     }
 
     auto end() const {
-        return pages_.end();
+        return PageIterator<Iterator>(end_, end_, page_size_);
     }
 
     size_t size() const {
-        return pages_.size();
+        const size_t items_count = std::distance(begin_, end_);
+        return (items_count + page_size_ - 1) / page_size_;
     }
 
 private:
-    std::vector<IteratorRange<Iterator>> pages_;
+    Iterator begin_;
+    Iterator end_;
+    size_t page_size_;
 };
 
 template <typename Container>
 auto Paginate(const Container& c, size_t page_size) {
     return Paginator(begin(c), end(c), page_size);
-}
\ No newline at end of file
+}
+
+template <typename Iterator>
+auto Paginate(Iterator range_begin, Iterator range_end, size_t page_size) {
+    return Paginator(range_begin, range_end, page_size);
+}
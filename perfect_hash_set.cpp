@@ -0,0 +1,49 @@
+#include "perfect_hash_set.h"
+
+bool PerfectHashSet::Contains(const std::string_view& word) const {
+    if (size_ == 0) {
+        return false;
+    }
+    // У пустой корзины seed равен 0: слово попадает в произвольную ячейку, и сравнение строк его отвергает
+    const uint64_t seed = seeds_[HashString(word, 0) % size_];
+    return words_[HashString(word, seed) % size_] == word;
+}
+
+size_t PerfectHashSet::size() const {
+    return size_;
+}
+
+const std::string_view* PerfectHashSet::begin() const {
+    return words_;
+}
+
+const std::string_view* PerfectHashSet::end() const {
+    return words_ + size_;
+}
+
+void PerfectHashSet::Build(std::vector<std::string> words) {
+    std::sort(words.begin(), words.end());
+    words.erase(std::unique(words.begin(), words.end()), words.end());
+
+    auto table = std::make_shared<OwnedTable>();
+    table->words = std::move(words);
+    const size_t size = table->words.size();
+    std::vector<int> slots(size);
+    std::vector<int> bucket_words(size);
+    std::vector<int> bucket_starts(size);
+    table->seeds.resize(size);
+    BuildTable(table->words, slots, table->seeds, bucket_words, bucket_starts);
+    table->slot_words.reserve(size);
+    for (const int index : slots) {
+        table->slot_words.push_back(table->words[index]);
+    }
+
+    SetTable(std::move(table));
+}
+
+void PerfectHashSet::SetTable(std::shared_ptr<OwnedTable> table) {
+    words_ = table->slot_words.data();
+    seeds_ = table->seeds.data();
+    size_ = table->slot_words.size();
+    owned_table_ = std::move(table);
+}
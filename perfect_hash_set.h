@@ -0,0 +1,183 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "string_processing.h"
+
+// Сколько seed перебирается для одной корзины, прежде чем построение таблицы признаётся неудачным
+const uint64_t MAX_PERFECT_HASH_SEED = 1 << 20;
+
+// Таблица минимальной совершенной хеш-функции для N слов, построенная при компиляции MakePerfectHashTable
+template <size_t N>
+struct PerfectHashTable {
+    std::array<std::string_view, N> words;   // слово каждой ячейки
+    std::array<uint64_t, N> seeds;           // seed каждой корзины
+};
+
+// Неизменяемое множество строк с минимальным совершенным хешированием (схема «hash and displace»).
+// Слова раскладываются по n корзинам, для каждой корзины подбирается seed, при котором слова всех корзин
+// попадают в разные ячейки общей таблицы из n ячеек — по одной на слово. Проверка — два хеширования
+// и одно сравнение строк
+class PerfectHashSet {
+public:
+    PerfectHashSet() = default;
+
+    // Строит таблицу во время выполнения; повторяющиеся слова схлопываются
+    template <typename StringContainer>
+    explicit PerfectHashSet(const StringContainer& words);
+
+    // Множество над таблицей, построенной при компиляции. Слова и seed копируются, поэтому таблица
+    // может быть и локальной переменной
+    template <size_t N>
+    explicit PerfectHashSet(const PerfectHashTable<N>& table);
+
+    bool Contains(const std::string_view& word) const;
+
+    size_t size() const;
+
+    // Слова в порядке ячеек таблицы
+    const std::string_view* begin() const;
+
+    const std::string_view* end() const;
+
+    // Раскладывает слова words по ячейкам: slots[i] — номер слова в ячейке i, seeds[b] — seed корзины b.
+    // Корзины обрабатываются по убыванию размера, пока таблица свободна. Все массивы размера words.size():
+    // std::array при компиляции и std::vector во время выполнения; bucket_words и bucket_starts — рабочая память.
+    // Бросает std::invalid_argument для повторяющихся слов и std::runtime_error, если для корзины
+    // не нашёлся seed не больше MAX_PERFECT_HASH_SEED
+    template <typename Words, typename Indices, typename Seeds>
+    static constexpr void BuildTable(const Words& words, Indices& slots, Seeds& seeds,
+                                     Indices& bucket_words, Indices& bucket_starts);
+
+private:
+    // Копии множества разделяют таблицу
+    struct OwnedTable {
+        std::vector<std::string> words;
+        std::vector<std::string_view> slot_words;
+        std::vector<uint64_t> seeds;
+    };
+
+    std::shared_ptr<const OwnedTable> owned_table_;
+    const std::string_view* words_ = nullptr;
+    const uint64_t* seeds_ = nullptr;
+    size_t size_ = 0;
+
+    void Build(std::vector<std::string> words);
+
+    void SetTable(std::shared_ptr<OwnedTable> table);
+};
+
+// Строит таблицу при компиляции:
+// static constexpr auto STOP_WORDS = MakePerfectHashTable(std::array{"and"sv, "in"sv});
+// Повторяющиеся слова — ошибка компиляции
+template <size_t N>
+constexpr PerfectHashTable<N> MakePerfectHashTable(const std::array<std::string_view, N>& words) {
+    std::array<int, N> slots{};
+    std::array<int, N> bucket_words{};
+    std::array<int, N> bucket_starts{};
+    PerfectHashTable<N> table{};
+    PerfectHashSet::BuildTable(words, slots, table.seeds, bucket_words, bucket_starts);
+    for (size_t i = 0; i < N; ++i) {
+        table.words[i] = words[slots[i]];
+    }
+    return table;
+}
+
+template <typename StringContainer>
+PerfectHashSet::PerfectHashSet(const StringContainer& words) {
+    std::vector<std::string> owned_words;
+    for (const auto& word : words) {
+        owned_words.emplace_back(word);
+    }
+    Build(std::move(owned_words));
+}
+
+template <size_t N>
+PerfectHashSet::PerfectHashSet(const PerfectHashTable<N>& table) {
+    auto owned_table = std::make_shared<OwnedTable>();
+    owned_table->words.assign(table.words.begin(), table.words.end());
+    owned_table->slot_words.assign(owned_table->words.begin(), owned_table->words.end());
+    owned_table->seeds.assign(table.seeds.begin(), table.seeds.end());
+    SetTable(std::move(owned_table));
+}
+
+template <typename Words, typename Indices, typename Seeds>
+constexpr void PerfectHashSet::BuildTable(const Words& words, Indices& slots, Seeds& seeds,
+                                          Indices& bucket_words, Indices& bucket_starts) {
+    const size_t size = words.size();
+    if (size == 0) {
+        return;
+    }
+    const auto get_bucket = [size](const std::string_view& word) {
+        return static_cast<size_t>(HashString(word, 0) % size);
+    };
+
+    // Сортировка подсчётом: слова корзины b — bucket_words[bucket_starts[b], bucket_starts[b + 1])
+    for (size_t b = 0; b < size; ++b) {
+        bucket_starts[b] = 0;
+    }
+    for (size_t i = 0; i < size; ++i) {
+        ++bucket_starts[get_bucket(words[i])];
+    }
+    int max_bucket_size = 0;
+    int offset = 0;
+    for (size_t b = 0; b < size; ++b) {
+        const int bucket_size = bucket_starts[b];
+        max_bucket_size = std::max(max_bucket_size, bucket_size);
+        bucket_starts[b] = offset;
+        offset += bucket_size;
+    }
+    // Ячейки пока служат курсорами заполнения корзин
+    for (size_t b = 0; b < size; ++b) {
+        slots[b] = bucket_starts[b];
+    }
+    for (size_t i = 0; i < size; ++i) {
+        bucket_words[slots[get_bucket(words[i])]++] = static_cast<int>(i);
+    }
+
+    for (size_t i = 0; i < size; ++i) {
+        slots[i] = -1;
+        seeds[i] = 0;
+    }
+    for (int bucket_size = max_bucket_size; bucket_size > 0; --bucket_size) {
+        for (size_t b = 0; b < size; ++b) {
+            const int begin = bucket_starts[b];
+            const int end = b + 1 < size ? bucket_starts[b + 1] : static_cast<int>(size);
+            if (end - begin != bucket_size) {
+                continue;
+            }
+            for (int i = begin; i < end; ++i) {
+                for (int j = begin; j < i; ++j) {
+                    if (std::string_view(words[bucket_words[i]]) == std::string_view(words[bucket_words[j]])) {
+                        throw std::invalid_argument("Perfect hash words must be unique");
+                    }
+                }
+            }
+            for (uint64_t seed = 1;; ++seed) {
+                if (seed > MAX_PERFECT_HASH_SEED) {
+                    throw std::runtime_error("Perfect hash seed is not found");
+                }
+                int placed_end = begin;
+                while (placed_end < end) {
+                    auto& slot = slots[HashString(words[bucket_words[placed_end]], seed) % size];
+                    if (slot >= 0) {
+                        break;
+                    }
+                    slot = bucket_words[placed_end++];
+                }
+                if (placed_end == end) {
+                    seeds[b] = seed;
+                    break;
+                }
+                for (int i = begin; i < placed_end; ++i) {
+                    slots[HashString(words[bucket_words[i]], seed) % size] = -1;
+                }
+            }
+        }
+    }
+}
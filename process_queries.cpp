@@ -28,4 +28,30 @@ std::list<Document> ProcessQueriesJoined(
         }
     }
     return result;
+}
+
+std::vector<std::vector<Document>> ProcessQueriesBatched(
+    const SearchServer& search_server,
+    const std::vector<std::string>& queries) {
+    const size_t chunk_count = std::min<size_t>(PROCESSOR_CORES, queries.size());
+    std::vector<std::vector<std::string_view>> chunks(chunk_count);
+    for (size_t i = 0; i < queries.size(); ++i) {
+        chunks[i * chunk_count / queries.size()].push_back(queries[i]);
+    }
+
+    std::vector<std::vector<std::vector<Document>>> chunk_results(chunk_count);
+    std::transform(std::execution::par
+        , chunks.begin()
+        , chunks.end()
+        , chunk_results.begin()
+        ,[&search_server](const std::vector<std::string_view>& chunk) {
+            return search_server.FindTopDocumentsBatch(chunk);
+        });
+
+    std::vector<std::vector<Document>> result;
+    result.reserve(queries.size());
+    for (auto& chunk_result : chunk_results) {
+        std::move(chunk_result.begin(), chunk_result.end(), std::back_inserter(result));
+    }
+    return result;
 }
\ No newline at end of file
@@ -9,5 +9,11 @@ std::vector<std::vector<Document>> ProcessQueries(
     const std::vector<std::string>& queries);
 
 std::list<Document> ProcessQueriesJoined(
+    const SearchServer& search_server,
+    const std::vector<std::string>& queries);
+
+// Как ProcessQueries, но запросы делятся на PROCESSOR_CORES частей, и внутри части
+// список документов каждого слова проходится один раз для всех запросов с этим словом
+std::vector<std::vector<Document>> ProcessQueriesBatched(
     const SearchServer& search_server,
     const std::vector<std::string>& queries);
\ No newline at end of file
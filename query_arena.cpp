@@ -0,0 +1,73 @@
+#include "query_arena.h"
+#include <algorithm>
+
+QueryArena::QueryArena()
+    : QueryArena(GetThreadScratch().is_used ? nullptr : &GetThreadScratch()) {
+}
+
+QueryArena::QueryArena(ThreadScratch* scratch)
+    : scratch_(scratch)
+    , resource_(scratch == nullptr
+                ? std::pmr::monotonic_buffer_resource(&overflow_)
+                : std::pmr::monotonic_buffer_resource(scratch->buffer.data(), scratch->buffer.size(), &overflow_)) {
+    if (scratch_ != nullptr) {
+        scratch_->is_used = true;
+    }
+}
+
+QueryArena::~QueryArena() {
+    resource_.release();
+    if (scratch_ == nullptr) {
+        return;
+    }
+    const size_t buffer_size = std::min(scratch_->buffer.size() + overflow_.GetAllocatedBytes(),
+                                        QUERY_ARENA_MAX_RETAINED_SIZE);
+    if (buffer_size != scratch_->buffer.size()) {
+        std::vector<std::byte>(buffer_size).swap(scratch_->buffer);
+    }
+    scratch_->is_used = false;
+}
+
+std::pmr::memory_resource* QueryArena::GetResource() {
+    return &resource_;
+}
+
+QueryArena::ThreadScratch& QueryArena::GetThreadScratch() {
+    thread_local ThreadScratch scratch{std::vector<std::byte>(QUERY_ARENA_INITIAL_SIZE)};
+    return scratch;
+}
+
+size_t QueryArena::OverflowResource::GetAllocatedBytes() const {
+    return allocated_bytes_;
+}
+
+void* QueryArena::OverflowResource::do_allocate(size_t bytes, size_t alignment) {
+    allocated_bytes_ += bytes;
+    return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+}
+
+void QueryArena::OverflowResource::do_deallocate(void* p, size_t bytes, size_t alignment) {
+    std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+}
+
+bool QueryArena::OverflowResource::do_is_equal(const std::pmr::memory_resource& other) const noexcept {
+    return this == &other;
+}
+
+SynchronizedResource::SynchronizedResource(std::pmr::memory_resource* upstream)
+    : upstream_(upstream) {
+}
+
+void* SynchronizedResource::do_allocate(size_t bytes, size_t alignment) {
+    std::lock_guard guard(mutex_);
+    return upstream_->allocate(bytes, alignment);
+}
+
+void SynchronizedResource::do_deallocate(void* p, size_t bytes, size_t alignment) {
+    std::lock_guard guard(mutex_);
+    upstream_->deallocate(p, bytes, alignment);
+}
+
+bool SynchronizedResource::do_is_equal(const std::pmr::memory_resource& other) const noexcept {
+    return this == &other;
+}
@@ -0,0 +1,68 @@
+#pragma once
+#include <cstddef>
+#include <memory_resource>
+#include <mutex>
+#include <vector>
+
+const size_t QUERY_ARENA_INITIAL_SIZE = 64 * 1024;
+// Больше этого буфер потока не растёт: редкий тяжёлый запрос не должен навсегда занимать память каждого потока
+const size_t QUERY_ARENA_MAX_RETAINED_SIZE = 4 * 1024 * 1024;
+
+// Арена одного запроса: монотонный ресурс поверх буфера, который поток переиспользует между запросами.
+// Если запросу не хватило буфера, остаток берётся из кучи, а буфер потока увеличивается для следующих запросов,
+// но не больше QUERY_ARENA_MAX_RETAINED_SIZE.
+// Вложенная арена в том же потоке работает без общего буфера
+// Последовательный поиск с прогретым буфером выделяет из кучи только вектор результата. Параллельный поиск
+// этого не гарантирует: арена TBB, которую он создаёт на каждый запрос, выделяет свои данные из кучи
+class QueryArena {
+public:
+    QueryArena();
+
+    QueryArena(const QueryArena&) = delete;
+    QueryArena& operator=(const QueryArena&) = delete;
+
+    ~QueryArena();
+
+    std::pmr::memory_resource* GetResource();
+
+private:
+    struct ThreadScratch {
+        std::vector<std::byte> buffer;
+        bool is_used = false;
+    };
+
+    // Ресурс кучи, запоминающий, сколько байт понадобилось сверх буфера потока
+    class OverflowResource : public std::pmr::memory_resource {
+    public:
+        size_t GetAllocatedBytes() const;
+
+    private:
+        size_t allocated_bytes_ = 0;
+
+        void* do_allocate(size_t bytes, size_t alignment) override;
+        void do_deallocate(void* p, size_t bytes, size_t alignment) override;
+        bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override;
+    };
+
+    static ThreadScratch& GetThreadScratch();
+
+    ThreadScratch* scratch_ = nullptr;
+    OverflowResource overflow_;
+    std::pmr::monotonic_buffer_resource resource_;
+
+    explicit QueryArena(ThreadScratch* scratch);
+};
+
+// Потокобезопасная обёртка над ресурсом, который сам по себе не синхронизирован (например, над ареной запроса)
+class SynchronizedResource : public std::pmr::memory_resource {
+public:
+    explicit SynchronizedResource(std::pmr::memory_resource* upstream);
+
+private:
+    std::mutex mutex_;
+    std::pmr::memory_resource* upstream_;
+
+    void* do_allocate(size_t bytes, size_t alignment) override;
+    void do_deallocate(void* p, size_t bytes, size_t alignment) override;
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override;
+};
@@ -0,0 +1,630 @@
+#include "search_daemon.h"
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cerrno>
+#include <charconv>
+#include <exception>
+#include <cstring>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <system_error>
+#include <unistd.h>
+
+namespace {
+
+// Идентификаторы в epoll_event.data: служебные дескрипторы, затем соединения
+const uint64_t EVENT_ID = 0;
+const uint64_t TCP_LISTENER_ID = 1;
+const uint64_t UNIX_LISTENER_ID = 2;
+const uint64_t FIRST_CONNECTION_ID = 3;
+
+const size_t READ_BUFFER_SIZE = 64 * 1024;
+const size_t MAX_IOVEC_COUNT = 64;
+const int MAX_EPOLL_EVENTS = 256;
+
+void ThrowSystemError(const std::string& what) {
+    throw std::system_error(errno, std::generic_category(), what);
+}
+
+void AddToEpoll(int epoll_descriptor, int file_descriptor, uint64_t id, uint32_t events) {
+    epoll_event event{};
+    event.events = events;
+    event.data.u64 = id;
+    if (::epoll_ctl(epoll_descriptor, EPOLL_CTL_ADD, file_descriptor, &event) != 0) {
+        ThrowSystemError("epoll_ctl failed");
+    }
+}
+
+// Отделяет от text первое слово
+std::string_view TakeWord(std::string_view& text) {
+    const size_t space = text.find(' ');
+    const std::string_view word = text.substr(0, space);
+    text.remove_prefix(space == std::string_view::npos ? text.size() : space + 1);
+    return word;
+}
+
+template <typename Number>
+Number TakeNumber(std::string_view& text) {
+    const std::string_view word = TakeWord(text);
+    Number value{};
+    const auto [end, error] = std::from_chars(word.data(), word.data() + word.size(), value);
+    if (error != std::errc() || end != word.data() + word.size()) {
+        throw std::invalid_argument("Expected number instead of \"" + std::string(word) + "\"");
+    }
+    return value;
+}
+
+}  // namespace
+
+SearchDaemon::SearchDaemon(SearchServer& search_server, const SearchDaemonOptions& options, WriteAheadLog* log)
+    : search_server_(search_server)
+    , log_(log)
+    , options_(options)
+    , next_connection_id_(FIRST_CONNECTION_ID) {
+    if (options_.tcp_port < 0 && options_.unix_socket_path.empty()) {
+        throw std::invalid_argument("No TCP port or Unix socket to listen on");
+    }
+    if (options_.worker_count == 0 || options_.max_pipelined_requests == 0 || options_.max_queued_requests == 0) {
+        throw std::invalid_argument("Worker count, pipeline depth and queue size must be positive");
+    }
+
+    epoll_descriptor_ = ::epoll_create1(EPOLL_CLOEXEC);
+    event_descriptor_ = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (epoll_descriptor_ < 0 || event_descriptor_ < 0) {
+        ThrowSystemError("Cannot create event loop");
+    }
+    AddToEpoll(epoll_descriptor_, event_descriptor_, EVENT_ID, EPOLLIN);
+    Listen();
+
+    for (size_t i = 0; i < options_.worker_count; ++i) {
+        workers_.emplace_back([this] {
+            RunWorker();
+        });
+    }
+}
+
+SearchDaemon::~SearchDaemon() {
+    {
+        std::lock_guard guard(tasks_mutex_);
+        are_workers_stopping_ = true;
+    }
+    has_tasks_.notify_all();
+    for (std::thread& worker : workers_) {
+        worker.join();
+    }
+    for (const auto& [_, connection] : connections_) {
+        ::close(connection.file_descriptor);
+    }
+    for (const int file_descriptor : {tcp_listener_, unix_listener_, event_descriptor_, epoll_descriptor_}) {
+        if (file_descriptor >= 0) {
+            ::close(file_descriptor);
+        }
+    }
+    if (unix_listener_ >= 0) {
+        ::unlink(options_.unix_socket_path.c_str());
+    }
+}
+
+void SearchDaemon::Listen() {
+    if (options_.tcp_port >= 0) {
+        tcp_listener_ = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (tcp_listener_ < 0) {
+            ThrowSystemError("Cannot create TCP socket");
+        }
+        const int enable = 1;
+        ::setsockopt(tcp_listener_, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+        sockaddr_in address{};
+        address.sin_family = AF_INET;
+        address.sin_port = htons(static_cast<uint16_t>(options_.tcp_port));
+        if (::inet_pton(AF_INET, options_.tcp_address.c_str(), &address.sin_addr) != 1) {
+            throw std::invalid_argument("Invalid TCP address " + options_.tcp_address);
+        }
+        if (::bind(tcp_listener_, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0
+            || ::listen(tcp_listener_, SOMAXCONN) != 0) {
+            ThrowSystemError("Cannot listen on " + options_.tcp_address + ':' + std::to_string(options_.tcp_port));
+        }
+        socklen_t address_size = sizeof(address);
+        ::getsockname(tcp_listener_, reinterpret_cast<sockaddr*>(&address), &address_size);
+        tcp_port_ = ntohs(address.sin_port);
+        AddToEpoll(epoll_descriptor_, tcp_listener_, TCP_LISTENER_ID, EPOLLIN);
+    }
+
+    if (!options_.unix_socket_path.empty()) {
+        sockaddr_un address{};
+        address.sun_family = AF_UNIX;
+        if (options_.unix_socket_path.size() >= sizeof(address.sun_path)) {
+            throw std::invalid_argument("Unix socket path " + options_.unix_socket_path + " is too long");
+        }
+        std::memcpy(address.sun_path, options_.unix_socket_path.c_str(), options_.unix_socket_path.size() + 1);
+        unix_listener_ = ::socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (unix_listener_ < 0) {
+            ThrowSystemError("Cannot create Unix socket");
+        }
+        ::unlink(options_.unix_socket_path.c_str());
+        if (::bind(unix_listener_, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0
+            || ::listen(unix_listener_, SOMAXCONN) != 0) {
+            ThrowSystemError("Cannot listen on " + options_.unix_socket_path);
+        }
+        AddToEpoll(epoll_descriptor_, unix_listener_, UNIX_LISTENER_ID, EPOLLIN);
+    }
+}
+
+void SearchDaemon::Run() {
+    std::vector<epoll_event> events(MAX_EPOLL_EVENTS);
+    while (!is_stopping_.load()) {
+        const int event_count = ::epoll_wait(epoll_descriptor_, events.data(), MAX_EPOLL_EVENTS, -1);
+        if (event_count < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            ThrowSystemError("epoll_wait failed");
+        }
+        for (int i = 0; i < event_count; ++i) {
+            const uint64_t id = events[i].data.u64;
+            if (id == EVENT_ID) {
+                uint64_t counter;
+                while (::read(event_descriptor_, &counter, sizeof(counter)) > 0) {
+                }
+                ProcessCompletions();
+            } else if (id == TCP_LISTENER_ID) {
+                AcceptConnections(tcp_listener_);
+            } else if (id == UNIX_LISTENER_ID) {
+                AcceptConnections(unix_listener_);
+            } else {
+                // Соединение могло закрыться при обработке предыдущего события
+                const auto connection_iter = connections_.find(id);
+                if (connection_iter == connections_.end()) {
+                    continue;
+                }
+                Connection& connection = connection_iter->second;
+                if (events[i].events & (EPOLLERR | EPOLLHUP)) {
+                    CloseConnection(id);
+                    continue;
+                }
+                if ((events[i].events & EPOLLOUT) && !FlushOutput(id, connection)) {
+                    CloseConnection(id);
+                    continue;
+                }
+                if (events[i].events & (EPOLLIN | EPOLLRDHUP)) {
+                    ReadConnection(id, connection);
+                } else {
+                    CloseIfDone(id, connection);
+                }
+            }
+        }
+    }
+}
+
+void SearchDaemon::Stop() {
+    is_stopping_.store(true);
+    const uint64_t counter = 1;
+    [[maybe_unused]] const ssize_t written = ::write(event_descriptor_, &counter, sizeof(counter));
+}
+
+int SearchDaemon::GetTcpPort() const {
+    return tcp_port_;
+}
+
+void SearchDaemon::AcceptConnections(int listener) {
+    while (true) {
+        const int file_descriptor = ::accept4(listener, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (file_descriptor < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR && errno != ECONNABORTED) {
+                ThrowSystemError("accept failed");
+            }
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            return;
+        }
+        if (listener == tcp_listener_) {
+            // Ответы уходят сразу целыми пачками, поэтому алгоритм Нейгла только добавил бы задержку
+            const int enable = 1;
+            ::setsockopt(file_descriptor, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+        }
+        const uint64_t connection_id = next_connection_id_++;
+        connections_[connection_id].file_descriptor = file_descriptor;
+        AddToEpoll(epoll_descriptor_, file_descriptor, connection_id, EPOLLIN | EPOLLRDHUP);
+    }
+}
+
+void SearchDaemon::ReadConnection(uint64_t connection_id, Connection& connection) {
+    char buffer[READ_BUFFER_SIZE];
+    // Запросы разбираются после каждого чтения, чтобы перестать читать, как только очередь заполнится:
+    // непрочитанные данные остаются в сокете, и клиент упирается в его буфер
+    while (!connection.is_input_closed && connection.pending_requests.size() < options_.max_queued_requests) {
+        const ssize_t read_size = ::read(connection.file_descriptor, buffer, sizeof(buffer));
+        if (read_size > 0) {
+            connection.input.append(buffer, read_size);
+        } else if (read_size == 0) {
+            connection.is_input_closed = true;
+        } else if (errno == EINTR) {
+            continue;
+        } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            break;
+        } else {
+            CloseConnection(connection_id);
+            return;
+        }
+
+        size_t line_begin = 0;
+        for (size_t line_end; (line_end = connection.input.find('\n', line_begin)) != std::string::npos;
+             line_begin = line_end + 1) {
+            size_t line_size = line_end - line_begin;
+            if (line_size > 0 && connection.input[line_end - 1] == '\r') {
+                --line_size;
+            }
+            connection.pending_requests.emplace_back(connection.input, line_begin, line_size);
+        }
+        connection.input.erase(0, line_begin);
+        if (connection.input.size() > MAX_REQUEST_LINE_SIZE) {
+            CloseConnection(connection_id);
+            return;
+        }
+    }
+    if (connection.pending_requests.size() >= options_.max_queued_requests) {
+        UpdateReadInterest(connection_id, connection, true);
+    }
+    if (connection.is_input_closed) {
+        // Клиент больше не пишет: события чтения не нужны, а соединение живёт, пока не отправлены ответы
+        ::epoll_ctl(epoll_descriptor_, EPOLL_CTL_DEL, connection.file_descriptor, nullptr);
+        connection.is_waiting_writable = false;
+        UpdateWriteInterest(connection_id, connection, !connection.output.empty());
+    }
+
+    DispatchRequests(connection_id, connection);
+    CloseIfDone(connection_id, connection);
+}
+
+void SearchDaemon::DispatchRequests(uint64_t connection_id, Connection& connection) {
+    while (!connection.pending_requests.empty() && !connection.is_barrier_in_flight
+           && connection.in_flight_count < options_.max_pipelined_requests) {
+        const bool is_barrier = IsMutatingRequest(connection.pending_requests.front());
+        if (is_barrier && connection.in_flight_count > 0) {
+            break;
+        }
+        std::string request = std::move(connection.pending_requests.front());
+        connection.pending_requests.pop_front();
+        const uint64_t sequence = connection.next_request_sequence++;
+        ++connection.in_flight_count;
+        connection.is_barrier_in_flight = is_barrier;
+
+        EnqueueTask([this, connection_id, sequence, is_barrier, request = std::move(request)] {
+            Completion completion{connection_id, sequence, HandleRequest(request), is_barrier};
+            {
+                std::lock_guard guard(completions_mutex_);
+                completions_.push_back(std::move(completion));
+            }
+            const uint64_t counter = 1;
+            [[maybe_unused]] const ssize_t written = ::write(event_descriptor_, &counter, sizeof(counter));
+        });
+    }
+    if (connection.pending_requests.size() < options_.max_queued_requests) {
+        UpdateReadInterest(connection_id, connection, false);
+    }
+}
+
+void SearchDaemon::ProcessCompletions() {
+    std::vector<Completion> completions;
+    {
+        std::lock_guard guard(completions_mutex_);
+        completions.swap(completions_);
+    }
+    for (Completion& completion : completions) {
+        const auto connection_iter = connections_.find(completion.connection_id);
+        if (connection_iter == connections_.end()) {
+            continue;
+        }
+        Connection& connection = connection_iter->second;
+        --connection.in_flight_count;
+        if (completion.is_barrier) {
+            connection.is_barrier_in_flight = false;
+        }
+        completion.response.push_back('\n');
+        connection.ready_responses.emplace(completion.sequence, std::move(completion.response));
+        for (auto response_iter = connection.ready_responses.begin();
+             response_iter != connection.ready_responses.end() && response_iter->first == connection.next_response_sequence;
+             response_iter = connection.ready_responses.erase(response_iter)) {
+            connection.output.push_back(std::move(response_iter->second));
+            ++connection.next_response_sequence;
+        }
+        DispatchRequests(completion.connection_id, connection);
+    }
+
+    // Ответы соединения отправляются одним вызовом после разбора всех готовых задач
+    for (const Completion& completion : completions) {
+        const auto connection_iter = connections_.find(completion.connection_id);
+        if (connection_iter == connections_.end()) {
+            continue;
+        }
+        if (!FlushOutput(completion.connection_id, connection_iter->second)) {
+            CloseConnection(completion.connection_id);
+            continue;
+        }
+        CloseIfDone(completion.connection_id, connection_iter->second);
+    }
+}
+
+bool SearchDaemon::FlushOutput(uint64_t connection_id, Connection& connection) {
+    while (!connection.output.empty()) {
+        iovec buffers[MAX_IOVEC_COUNT];
+        size_t buffer_count = 0;
+        for (auto it = connection.output.begin(); it != connection.output.end() && buffer_count < MAX_IOVEC_COUNT;
+             ++it, ++buffer_count) {
+            const size_t offset = buffer_count == 0 ? connection.output_offset : 0;
+            buffers[buffer_count].iov_base = it->data() + offset;
+            buffers[buffer_count].iov_len = it->size() - offset;
+        }
+        msghdr message{};
+        message.msg_iov = buffers;
+        message.msg_iovlen = buffer_count;
+        ssize_t written = ::sendmsg(connection.file_descriptor, &message, MSG_NOSIGNAL);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                UpdateWriteInterest(connection_id, connection, true);
+                return true;
+            }
+            return false;
+        }
+        while (written > 0) {
+            const size_t rest = connection.output.front().size() - connection.output_offset;
+            if (static_cast<size_t>(written) < rest) {
+                connection.output_offset += written;
+                break;
+            }
+            written -= rest;
+            connection.output.pop_front();
+            connection.output_offset = 0;
+        }
+    }
+    UpdateWriteInterest(connection_id, connection, false);
+    return true;
+}
+
+void SearchDaemon::UpdateWriteInterest(uint64_t connection_id, Connection& connection, bool is_waiting_writable) {
+    if (connection.is_waiting_writable == is_waiting_writable) {
+        return;
+    }
+    connection.is_waiting_writable = is_waiting_writable;
+    epoll_event event{};
+    event.events = (connection.is_input_closed || connection.is_reading_paused ? 0u : EPOLLIN | EPOLLRDHUP)
+                 | (is_waiting_writable ? EPOLLOUT : 0u);
+    event.data.u64 = connection_id;
+    // После закрытия входа дескриптор удалён из epoll и возвращается туда только на время ожидания записи
+    const int operation = connection.is_input_closed ? (is_waiting_writable ? EPOLL_CTL_ADD : EPOLL_CTL_DEL)
+                                                     : EPOLL_CTL_MOD;
+    ::epoll_ctl(epoll_descriptor_, operation, connection.file_descriptor, &event);
+}
+
+void SearchDaemon::UpdateReadInterest(uint64_t connection_id, Connection& connection, bool is_reading_paused) {
+    if (connection.is_input_closed || connection.is_reading_paused == is_reading_paused) {
+        return;
+    }
+    connection.is_reading_paused = is_reading_paused;
+    epoll_event event{};
+    event.events = (is_reading_paused ? 0u : EPOLLIN | EPOLLRDHUP) | (connection.is_waiting_writable ? EPOLLOUT : 0u);
+    event.data.u64 = connection_id;
+    ::epoll_ctl(epoll_descriptor_, EPOLL_CTL_MOD, connection.file_descriptor, &event);
+}
+
+void SearchDaemon::CloseIfDone(uint64_t connection_id, Connection& connection) {
+    if (connection.is_input_closed && connection.pending_requests.empty() && connection.in_flight_count == 0
+        && connection.output.empty()) {
+        CloseConnection(connection_id);
+    }
+}
+
+void SearchDaemon::CloseConnection(uint64_t connection_id) {
+    const auto connection_iter = connections_.find(connection_id);
+    if (connection_iter == connections_.end()) {
+        return;
+    }
+    // Закрытый дескриптор сам удаляется из epoll; ответы запросов, которые ещё выполняются, будут отброшены
+    ::close(connection_iter->second.file_descriptor);
+    connections_.erase(connection_iter);
+}
+
+void SearchDaemon::EnqueueTask(std::function<void()> task) {
+    {
+        std::lock_guard guard(tasks_mutex_);
+        tasks_.push_back(std::move(task));
+    }
+    has_tasks_.notify_one();
+}
+
+void SearchDaemon::RunWorker() {
+    while (true) {
+        std::function<void()> task;
+        {
+            std::unique_lock lock(tasks_mutex_);
+            has_tasks_.wait(lock, [this] {
+                return are_workers_stopping_ || !tasks_.empty();
+            });
+            if (tasks_.empty()) {
+                return;
+            }
+            task = std::move(tasks_.front());
+            tasks_.pop_front();
+        }
+        task();
+    }
+}
+
+void SearchDaemon::ScheduleHeadTermCacheRefresh() {
+    if (!search_server_.IsHeadTermCacheRefreshDue() || is_head_term_refresh_scheduled_.exchange(true)) {
+        return;
+    }
+    EnqueueTask([this] {
+        {
+            std::shared_lock lock(server_mutex_);
+            search_server_.RefreshHeadTermCache();
+        }
+        is_head_term_refresh_scheduled_.store(false);
+    });
+}
+
+bool SearchDaemon::IsMutatingRequest(const std::string_view& request) {
+    const std::string_view command = request.substr(0, request.find(' '));
+    return command == "ADD" || command == "REMOVE" || command == "STATUS" || command == "RATING";
+}
+
+std::string SearchDaemon::HandleRequest(const std::string& request) {
+    try {
+        std::string_view arguments = request;
+        const std::string_view command = TakeWord(arguments);
+
+        if (command == "FIND") {
+            std::vector<Document> documents;
+            {
+                std::shared_lock lock(server_mutex_);
+                // Потоки пула уже заняты разными запросами, поэтому каждый запрос выполняется последовательно
+                documents = search_server_.FindTopDocuments(std::execution::seq, arguments);
+                ScheduleHeadTermCacheRefresh();
+            }
+            std::string response = "OK " + std::to_string(documents.size());
+            for (const Document& document : documents) {
+                response += ' ' + std::to_string(document.id) + ' ' + std::to_string(document.relevance)
+                          + ' ' + std::to_string(document.rating);
+            }
+            return response;
+        }
+
+        if (command == "MATCH") {
+            const int document_id = TakeNumber<int>(arguments);
+            std::shared_lock lock(server_mutex_);
+            const auto [words, status] = search_server_.MatchDocument(std::execution::seq, arguments, document_id);
+            std::string response = "OK " + std::to_string(static_cast<int>(status)) + ' ' + std::to_string(words.size());
+            for (const std::string_view& word : words) {
+                response += ' ';
+                response += word;
+            }
+            return response;
+        }
+
+        if (command == "ADD") {
+            const int document_id = TakeNumber<int>(arguments);
+            const auto status = static_cast<DocumentStatus>(TakeNumber<int>(arguments));
+            const size_t rating_count = TakeNumber<size_t>(arguments);
+            if (rating_count > arguments.size()) {
+                throw std::invalid_argument("Rating count exceeds request size");
+            }
+            std::vector<int> ratings(rating_count);
+            for (int& rating : ratings) {
+                rating = TakeNumber<int>(arguments);
+            }
+            ApplyLoggedUpdate(
+                [&] {
+                    log_->LogAddDocument(document_id, arguments, status, ratings);
+                },
+                [&] {
+                    std::unique_lock lock(server_mutex_);
+                    search_server_.AddDocument(document_id, arguments, status, ratings);
+                });
+            return "OK";
+        }
+
+        if (command == "REMOVE") {
+            const int document_id = TakeNumber<int>(arguments);
+            ApplyLoggedUpdate(
+                [&] {
+                    log_->LogRemoveDocument(document_id);
+                },
+                [&] {
+                    std::unique_lock lock(server_mutex_);
+                    search_server_.RemoveDocument(document_id);
+                });
+            return "OK";
+        }
+
+        // Статус и рейтинг меняются на месте одновременно с поисками, поэтому индекс блокируется только для чтения
+        if (command == "STATUS") {
+            const int document_id = TakeNumber<int>(arguments);
+            const auto status = static_cast<DocumentStatus>(TakeNumber<int>(arguments));
+            ApplyLoggedUpdate(
+                [&] {
+                    log_->LogUpdateDocumentStatus(document_id, status);
+                },
+                [&] {
+                    std::shared_lock lock(server_mutex_);
+                    search_server_.UpdateDocumentStatus(document_id, status);
+                });
+            return "OK";
+        }
+
+        if (command == "RATING") {
+            const int document_id = TakeNumber<int>(arguments);
+            const size_t rating_count = TakeNumber<size_t>(arguments);
+            if (rating_count > arguments.size()) {
+                throw std::invalid_argument("Rating count exceeds request size");
+            }
+            std::vector<int> ratings(rating_count);
+            for (int& rating : ratings) {
+                rating = TakeNumber<int>(arguments);
+            }
+            ApplyLoggedUpdate(
+                [&] {
+                    log_->LogUpdateDocumentRating(document_id, ratings);
+                },
+                [&] {
+                    std::shared_lock lock(server_mutex_);
+                    search_server_.UpdateDocumentRating(document_id, ratings);
+                });
+            return "OK";
+        }
+
+        return "ERR Unknown command " + std::string(command);
+    } catch (const std::exception& error) {
+        std::string response = "ERR ";
+        response += error.what();
+        std::replace(response.begin(), response.end(), '\n', ' ');
+        return response;
+    }
+}
+
+template <typename LogUpdate, typename ApplyUpdate>
+void SearchDaemon::ApplyLoggedUpdate(LogUpdate log_update, ApplyUpdate apply_update) {
+    uint64_t update_number = 0;
+    {
+        std::lock_guard guard(update_mutex_);
+        if (log_ != nullptr) {
+            log_update();
+        }
+        update_number = next_update_number_++;
+    }
+
+    // Сброс журнала ждут без блокировок, поэтому одновременные изменения уходят на диск одной пачкой
+    std::exception_ptr error;
+    if (log_ != nullptr) {
+        try {
+            log_->Sync();
+        } catch (...) {
+            error = std::current_exception();
+        }
+    }
+
+    std::unique_lock lock(update_mutex_);
+    update_applied_.wait(lock, [this, update_number] {
+        return applied_update_count_ == update_number;
+    });
+    // Изменение, отвергнутое индексом, отвергается и при восстановлении по журналу
+    if (!error) {
+        try {
+            apply_update();
+        } catch (...) {
+            error = std::current_exception();
+        }
+    }
+    ++applied_update_count_;
+    lock.unlock();
+    update_applied_.notify_all();
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
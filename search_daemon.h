@@ -0,0 +1,158 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "search_server.h"
+#include "write_ahead_log.h"
+
+const size_t MAX_REQUEST_LINE_SIZE = 1 << 20;
+
+struct SearchDaemonOptions {
+    std::string tcp_address = "127.0.0.1";
+    int tcp_port = -1;                           // -1 — не слушать TCP, 0 — выбрать свободный порт
+    std::string unix_socket_path;                // пустой — не слушать Unix-сокет
+    size_t worker_count = PROCESSOR_CORES;
+    size_t max_pipelined_requests = 64;          // наибольшее число запросов одного соединения в обработке
+    // Наибольшее число прочитанных запросов соединения, ждущих обработки; дальше сокет не читается
+    size_t max_queued_requests = 1024;
+};
+
+// Сервер поиска по сокетам. Протокол строковый, один запрос — одна строка, один ответ — одна строка:
+//   FIND <запрос>                                 -> OK <n> (<id> <relevance> <rating>){n}
+//   MATCH <id> <запрос>                           -> OK <status> <n> <слово>{n}
+//   ADD <id> <status> <n> <rating>{n} <текст>     -> OK
+//   REMOVE <id>                                   -> OK
+//   STATUS <id> <status>                          -> OK
+//   RATING <id> <n> <rating>{n}                   -> OK
+// Ошибка запроса — строка ERR <описание>. Клиент может отправлять запросы, не дожидаясь ответов:
+// ответы приходят в порядке запросов. Поток событий (epoll) только читает и пишет сокеты, а запросы
+// выполняет пул рабочих потоков. Поиски соединения выполняются параллельно, а изменения — после
+// завершения предыдущих запросов соединения и до начала следующих
+class SearchDaemon {
+public:
+    // Если задан log, изменение сначала пишется в журнал и сбрасывается на диск, а затем применяется к индексу
+    // в порядке журнала; если журнал не удалось сбросить, изменение не применяется и клиент получает ERR
+    SearchDaemon(SearchServer& search_server, const SearchDaemonOptions& options, WriteAheadLog* log = nullptr);
+
+    SearchDaemon(const SearchDaemon&) = delete;
+    SearchDaemon& operator=(const SearchDaemon&) = delete;
+
+    ~SearchDaemon();
+
+    // Обрабатывает соединения до вызова Stop
+    void Run();
+
+    // Можно вызывать из другого потока и из обработчика сигнала
+    void Stop();
+
+    // Порт TCP после привязки (полезно при tcp_port = 0)
+    int GetTcpPort() const;
+
+private:
+    struct Connection {
+        int file_descriptor = -1;
+        std::string input;
+        std::deque<std::string> pending_requests;
+        size_t in_flight_count = 0;
+        bool is_barrier_in_flight = false;
+        uint64_t next_request_sequence = 0;
+        uint64_t next_response_sequence = 0;
+        // Готовые ответы, которые ждут ответов на более ранние запросы
+        std::map<uint64_t, std::string> ready_responses;
+        // Ответы в порядке отправки; передаются в sendmsg одним массивом iovec без склейки
+        std::deque<std::string> output;
+        size_t output_offset = 0;
+        bool is_input_closed = false;
+        bool is_waiting_writable = false;
+        // Очередь pending_requests заполнена, и события чтения отключены
+        bool is_reading_paused = false;
+    };
+
+    struct Completion {
+        uint64_t connection_id;
+        uint64_t sequence;
+        std::string response;
+        bool is_barrier;
+    };
+
+    SearchServer& search_server_;
+    WriteAheadLog* log_;
+    SearchDaemonOptions options_;
+    std::shared_mutex server_mutex_;
+    // Изменения получают номера в порядке записи в журнал и применяются строго в этом порядке,
+    // хотя сброс журнала на диск они ждут одновременно. Захватывается раньше server_mutex_
+    std::mutex update_mutex_;
+    std::condition_variable update_applied_;
+    uint64_t next_update_number_ = 0;
+    uint64_t applied_update_count_ = 0;
+
+    int epoll_descriptor_ = -1;
+    int event_descriptor_ = -1;
+    int tcp_listener_ = -1;
+    int unix_listener_ = -1;
+    int tcp_port_ = -1;
+    std::atomic<bool> is_stopping_ = false;
+    // Пересмотр набора слов ускорителя однословных запросов уже стоит в очереди задач
+    std::atomic<bool> is_head_term_refresh_scheduled_ = false;
+
+    std::unordered_map<uint64_t, Connection> connections_;
+    uint64_t next_connection_id_;
+
+    std::mutex completions_mutex_;
+    std::vector<Completion> completions_;
+
+    std::mutex tasks_mutex_;
+    std::condition_variable has_tasks_;
+    std::deque<std::function<void()>> tasks_;
+    bool are_workers_stopping_ = false;
+    std::vector<std::thread> workers_;
+
+    void Listen();
+
+    void AcceptConnections(int listener);
+
+    void ReadConnection(uint64_t connection_id, Connection& connection);
+
+    void DispatchRequests(uint64_t connection_id, Connection& connection);
+
+    void ProcessCompletions();
+
+    // Отправляет накопленные ответы; возвращает false, если соединение нужно закрыть
+    bool FlushOutput(uint64_t connection_id, Connection& connection);
+
+    void UpdateWriteInterest(uint64_t connection_id, Connection& connection, bool is_waiting_writable);
+
+    void UpdateReadInterest(uint64_t connection_id, Connection& connection, bool is_reading_paused);
+
+    // Закрывает соединение, если клиент закрыл свою сторону и все его ответы отправлены
+    void CloseIfDone(uint64_t connection_id, Connection& connection);
+
+    void CloseConnection(uint64_t connection_id);
+
+    void EnqueueTask(std::function<void()> task);
+
+    void RunWorker();
+
+    std::string HandleRequest(const std::string& request);
+
+    // Пишет изменение в журнал (log_update), ждёт сброса журнала на диск и применяет изменение (apply_update)
+    // в порядке журнала. apply_update сам блокирует server_mutex_
+    template <typename LogUpdate, typename ApplyUpdate>
+    void ApplyLoggedUpdate(LogUpdate log_update, ApplyUpdate apply_update);
+
+    // Ставит пересмотр ускорителя однословных запросов отдельной задачей, чтобы его не ждал запрос клиента.
+    // Вызывается под разделяемой блокировкой server_mutex_
+    void ScheduleHeadTermCacheRefresh();
+
+    static bool IsMutatingRequest(const std::string_view& request);
+};
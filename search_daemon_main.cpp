@@ -0,0 +1,144 @@
+#include <csignal>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <string>
+#include "search_daemon.h"
+#include "search_server.h"
+#include "write_ahead_log.h"
+
+using namespace std;
+
+namespace {
+
+SearchDaemon* running_daemon = nullptr;
+
+void HandleStopSignal(int) {
+    if (running_daemon != nullptr) {
+        running_daemon->Stop();
+    }
+}
+
+void PrintUsage() {
+    cerr << "Usage: search_daemon [--port N] [--address A] [--unix PATH] [--workers N] [--pipeline N]\n"
+            "                     [--checkpoint PATH [--wal PATH]] [--documents PATH] [--stop-words WORDS]\n"
+            "                     [--queue N] [--head-terms N]\n"
+            "--documents: build a new index, one document per line, ids are line numbers starting from 1\n"
+            "--checkpoint with --wal: recover the index on start, log changes and save a checkpoint on exit\n"
+            "--queue: stop reading a connection while N parsed requests wait for a worker\n"
+            "--head-terms: keep precomputed results for N most frequent single-word queries\n";
+}
+
+bool FileExists(const string& path) {
+    return ifstream(path).good();
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    SearchDaemonOptions options;
+    string checkpoint_path;
+    string log_path;
+    string documents_path;
+    string stop_words;
+    size_t head_term_count = 0;
+    try {
+        for (int i = 1; i < argc; ++i) {
+            const string argument = argv[i];
+            if (i + 1 == argc) {
+                throw invalid_argument("Missing value for " + argument);
+            }
+            const string value = argv[++i];
+            if (argument == "--port") {
+                options.tcp_port = stoi(value);
+            } else if (argument == "--address") {
+                options.tcp_address = value;
+            } else if (argument == "--unix") {
+                options.unix_socket_path = value;
+            } else if (argument == "--workers") {
+                options.worker_count = stoul(value);
+            } else if (argument == "--pipeline") {
+                options.max_pipelined_requests = stoul(value);
+            } else if (argument == "--queue") {
+                options.max_queued_requests = stoul(value);
+            } else if (argument == "--checkpoint") {
+                checkpoint_path = value;
+            } else if (argument == "--wal") {
+                log_path = value;
+            } else if (argument == "--documents") {
+                documents_path = value;
+            } else if (argument == "--stop-words") {
+                stop_words = value;
+            } else if (argument == "--head-terms") {
+                head_term_count = stoul(value);
+            } else {
+                throw invalid_argument("Unknown option " + argument);
+            }
+        }
+        if (!log_path.empty() && checkpoint_path.empty()) {
+            throw invalid_argument("--wal requires --checkpoint");
+        }
+    } catch (const exception& error) {
+        cerr << error.what() << endl;
+        PrintUsage();
+        return 1;
+    }
+
+    try {
+        optional<SearchServer> search_server;
+        if (!checkpoint_path.empty() && FileExists(checkpoint_path)) {
+            if (!log_path.empty()) {
+                search_server.emplace(RecoverSearchServer(checkpoint_path, log_path));
+            } else {
+                ifstream checkpoint(checkpoint_path);
+                search_server.emplace(SearchServer::LoadCheckpoint(checkpoint));
+            }
+        } else {
+            search_server.emplace(stop_words);
+            if (!documents_path.empty()) {
+                ifstream documents(documents_path);
+                if (!documents) {
+                    throw invalid_argument("Cannot read " + documents_path);
+                }
+                int document_id = 0;
+                for (string line; getline(documents, line);) {
+                    search_server->AddDocument(++document_id, line, DocumentStatus::ACTUAL, {});
+                }
+            }
+        }
+        cerr << "Loaded " << search_server->GetDocumentCount() << " documents" << endl;
+        search_server->SetHeadTermCacheSize(head_term_count);
+
+        unique_ptr<WriteAheadLog> log;
+        if (!log_path.empty()) {
+            log = make_unique<WriteAheadLog>(log_path);
+            // Документы из --documents не попали в журнал, поэтому сразу сохраняем их в контрольной точке
+            log->Checkpoint(*search_server, checkpoint_path);
+        }
+
+        {
+            SearchDaemon daemon(*search_server, options, log.get());
+            running_daemon = &daemon;
+            signal(SIGINT, HandleStopSignal);
+            signal(SIGTERM, HandleStopSignal);
+            if (daemon.GetTcpPort() >= 0) {
+                cerr << "Listening on " << options.tcp_address << ':' << daemon.GetTcpPort() << endl;
+            }
+            if (!options.unix_socket_path.empty()) {
+                cerr << "Listening on " << options.unix_socket_path << endl;
+            }
+            daemon.Run();
+            running_daemon = nullptr;
+        }
+
+        // Деструктор демона дождался запросов, уже переданных рабочим потокам
+        if (log) {
+            log->Checkpoint(*search_server, checkpoint_path);
+        }
+    } catch (const exception& error) {
+        cerr << error.what() << endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,38 @@
+#include "search_deadline.h"
+
+CancellationToken::CancellationToken()
+    : is_cancelled_(std::make_shared<std::atomic<bool>>(false)) {
+}
+
+void CancellationToken::Cancel() {
+    is_cancelled_->store(true, std::memory_order_relaxed);
+}
+
+bool CancellationToken::IsCancelled() const {
+    return is_cancelled_->load(std::memory_order_relaxed);
+}
+
+SearchDeadline::SearchDeadline(Clock::time_point time_point)
+    : time_point_(time_point) {
+}
+
+SearchDeadline::SearchDeadline(const CancellationToken& token)
+    : time_point_(Clock::time_point::max())
+    , token_(token) {
+}
+
+SearchDeadline::SearchDeadline(Clock::time_point time_point, const CancellationToken& token)
+    : time_point_(time_point)
+    , token_(token) {
+}
+
+SearchDeadline SearchDeadline::After(Clock::duration timeout) {
+    return SearchDeadline(Clock::now() + timeout);
+}
+
+bool SearchDeadline::IsExpired() const {
+    if (token_ && token_->IsCancelled()) {
+        return true;
+    }
+    return time_point_ != Clock::time_point::max() && Clock::now() >= time_point_;
+}
@@ -0,0 +1,39 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <optional>
+
+// Флаг отмены запроса. Копии ссылаются на один флаг, поэтому отменить запрос можно из другого потока
+class CancellationToken {
+public:
+    CancellationToken();
+
+    void Cancel();
+
+    bool IsCancelled() const;
+
+private:
+    std::shared_ptr<std::atomic<bool>> is_cancelled_;
+};
+
+// Ограничение запроса: момент времени, после которого поиск прерывается, и (необязательно) флаг отмены
+class SearchDeadline {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    explicit SearchDeadline(Clock::time_point time_point);
+
+    explicit SearchDeadline(const CancellationToken& token);
+
+    SearchDeadline(Clock::time_point time_point, const CancellationToken& token);
+
+    // Дедлайн через timeout от текущего момента
+    static SearchDeadline After(Clock::duration timeout);
+
+    bool IsExpired() const;
+
+private:
+    Clock::time_point time_point_;
+    std::optional<CancellationToken> token_;
+};
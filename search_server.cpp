@@ -6,6 +6,34 @@
 #include <tuple>
 #include <cassert>
 #include <numeric>
+#include <iomanip>
+#include <limits>
+
+SearchServer::SearchServer(PerfectHashSet stop_words)
+    : memory_counters_(std::make_unique<IndexMemoryCounters>())
+    , query_counters_(std::make_unique<QueryCounters>())
+    , completion_cache_(std::make_unique<CompletionCache>())
+    , stop_words_(std::move(stop_words))
+    , documents_words(Dictionary::allocator_type(&memory_counters_->dictionary))
+    , word_to_document_freqs_(InvertedIndex::allocator_type(&memory_counters_->dictionary))
+    , documents_(DocumentsMetadata::allocator_type(&memory_counters_->document_metadata))
+    , document_ids_(DocumentIds::allocator_type(&memory_counters_->document_metadata))
+    , document_to_word_freqs_(ForwardIndex::allocator_type(&memory_counters_->forward_index)) {
+    if (!all_of(stop_words_.begin(), stop_words_.end(), [](const std::string_view& word) {
+            return !word.empty() && IsValidWord(word);
+        })) {
+        throw std::invalid_argument("Some of stop words are invalid");
+    }
+}
+
+SearchServer::SearchServer(const SearchServer& other)
+    : SearchServer(other.CreateEmptyCopy()) {
+    for (const int document_id : other.document_ids_) {
+        const DocumentData& document_data = other.documents_.at(document_id);
+        RestoreDocument(document_id, other.document_to_word_freqs_.at(document_id), document_data.status,
+                        document_data.rating);
+    }
+}
 
 SearchServer::SearchServer(const std::string& stop_words_text)
     : SearchServer::SearchServer(SplitIntoWords(stop_words_text)) {
@@ -20,16 +48,27 @@ void SearchServer::AddDocument(int document_id, const std::string_view& document
         throw std::invalid_argument("Invalid document_id");
     }
     const auto words = SplitIntoWordsNoStop(document);
+    if (memory_budget_ > 0) {
+        CheckMemoryBudget(words);
+    }
 
     const double inv_word_count = 1.0 / words.size();
+    const PostingList::allocator_type posting_allocator(&memory_counters_->postings);
+    auto& word_freqs = document_to_word_freqs_[document_id];
     for (const std::string_view& word : words) {
-        documents_words.insert(static_cast<std::string>(word));
-        auto word_iter = std::find( documents_words.begin(), documents_words.end(), word);
+        auto word_iter = documents_words.find(word);
+        if (word_iter == documents_words.end()) {
+            word_iter = documents_words.emplace(word.data(), word.size(), documents_words.get_allocator()).first;
+        }
         const std::string_view word_view{*(word_iter)};
-        word_to_document_freqs_[word_view][document_id] += inv_word_count;
-        document_to_word_freqs_[document_id][word_view] += inv_word_count;
+        word_to_document_freqs_.try_emplace(word_view, posting_allocator).first->second[document_id] += inv_word_count;
+        word_freqs[word_view] += inv_word_count;
     }
-    documents_.emplace(document_id, DocumentData{ComputeAverageRating(ratings), status});
+    AccountWordFrequencies(word_freqs, true);
+    const int rating = ComputeAverageRating(ratings);
+    documents_.try_emplace(document_id, rating, status);
+    AddToHeadTermCache(document_id, word_freqs, status, rating);
+    UpdateCompletionCache(word_freqs, true);
     document_ids_.push_back(document_id);
 }    
 
@@ -39,6 +78,11 @@ std::vector<Document> SearchServer::FindTopDocuments(const std::string_view& raw
 
 std::vector<Document> SearchServer::FindTopDocuments(const std::execution::sequenced_policy& seq_, const std::string_view& raw_query,
                                                      DocumentStatus status) const {
+    if (head_term_cache_ && status == DocumentStatus::ACTUAL) {
+        if (auto documents = FindTopDocumentsInHeadTermCache(raw_query)) {
+            return std::move(*documents);
+        }
+    }
     return FindTopDocuments(seq_, raw_query, [status](int document_id, DocumentStatus document_status, int rating) {
                             return document_status == status;
                         });
@@ -46,6 +90,11 @@ std::vector<Document> SearchServer::FindTopDocuments(const std::execution::seque
 
 std::vector<Document> SearchServer::FindTopDocuments(const std::execution::parallel_policy& par_, const std::string_view& raw_query,
                                                      DocumentStatus status) const {
+    if (head_term_cache_ && status == DocumentStatus::ACTUAL) {
+        if (auto documents = FindTopDocumentsInHeadTermCache(raw_query)) {
+            return std::move(*documents);
+        }
+    }
     return FindTopDocuments(par_, raw_query, [status](int document_id, DocumentStatus document_status, int rating) {
                             return document_status == status;
                         });
@@ -63,6 +112,157 @@ std::vector<Document> SearchServer::FindTopDocuments(const std::execution::paral
     return FindTopDocuments(par_, raw_query, DocumentStatus::ACTUAL);
 }
 
+SearchCursor SearchServer::CreateSearchCursor(const std::string_view& raw_query) const {
+    QueryArena arena;
+    const auto query = ParseQuery(raw_query, arena.GetResource());
+    auto terms = std::make_shared<SearchCursor::Terms>();
+    terms->plus_terms.reserve(query.plus_words.size());
+    for (const std::string_view& word : query.plus_words) {
+        if (word_to_document_freqs_.count(word) > 0) {
+            terms->plus_terms.push_back({std::string(word),
+                                         ComputeWordInverseDocumentFreq(word) * query.GetPlusWordWeight(word)});
+        }
+    }
+    terms->minus_words.assign(query.minus_words.begin(), query.minus_words.end());
+    SearchCursor cursor;
+    cursor.terms_ = std::move(terms);
+    return cursor;
+}
+
+SearchPage SearchServer::FindTopDocumentsAfter(const SearchCursor& cursor, DocumentStatus status) const {
+    return FindTopDocumentsAfter(cursor, [status](int document_id, DocumentStatus document_status, int rating) {
+                                     return document_status == status;
+                                 });
+}
+
+SearchPage SearchServer::FindTopDocumentsAfter(const SearchCursor& cursor) const {
+    return FindTopDocumentsAfter(cursor, DocumentStatus::ACTUAL);
+}
+
+std::vector<std::vector<Document>> SearchServer::FindTopDocumentsBatch(const std::vector<std::string_view>& raw_queries,
+                                                                       DocumentStatus status) const {
+    return FindTopDocumentsBatch(raw_queries, [status](int document_id, DocumentStatus document_status, int rating) {
+                                     return document_status == status;
+                                 });
+}
+
+std::vector<std::vector<Document>> SearchServer::FindTopDocumentsBatch(const std::vector<std::string_view>& raw_queries) const {
+    return FindTopDocumentsBatch(raw_queries, DocumentStatus::ACTUAL);
+}
+
+SearchResult SearchServer::FindTopDocuments(const std::execution::sequenced_policy& seq_, const std::string_view& raw_query,
+                                            const SearchDeadline& deadline) const {
+    return FindTopDocuments(seq_, raw_query, DocumentStatus::ACTUAL, deadline);
+}
+
+SearchResult SearchServer::FindTopDocuments(const std::execution::parallel_policy& par_, const std::string_view& raw_query,
+                                            const SearchDeadline& deadline) const {
+    return FindTopDocuments(par_, raw_query, DocumentStatus::ACTUAL, deadline);
+}
+
+SearchResult SearchServer::FindTopDocuments(const AutoExecutionPolicy& policy, const std::string_view& raw_query,
+                                            const SearchDeadline& deadline) const {
+    return FindTopDocuments(policy, raw_query, DocumentStatus::ACTUAL, deadline);
+}
+
+uint64_t SearchServer::GetTruncatedQueryCount() const {
+    return query_counters_->truncated.load(std::memory_order_relaxed);
+}
+
+void SearchServer::CollectQueryStatistics(const std::string_view& raw_query, CorpusStatistics& statistics) const {
+    QueryArena arena;
+    statistics.document_count += GetDocumentCount();
+    for (const std::string_view& word : ParseQuery(raw_query, arena.GetResource()).plus_words) {
+        const auto word_iter = word_to_document_freqs_.find(word);
+        if (word_iter != word_to_document_freqs_.end()) {
+            statistics.word_document_counts[static_cast<std::string>(word)] += word_iter->second.size();
+        }
+    }
+}
+
+void SearchServer::CollectQueryExpansion(const std::string_view& raw_query, QueryExpansion& expansion) const {
+    QueryArena arena;
+    expansion.document_count += GetDocumentCount();
+    size_t word_index = 0;
+    ForEachWord(raw_query, [&](const std::string_view& word) {
+        const auto query_word = ParseQueryWord(word);
+        if (query_word.is_stop) {
+            return;
+        }
+        // Стоп-слова у шардов общие, поэтому слова запроса у всех шардов идут в одном порядке
+        if (word_index == expansion.words.size()) {
+            expansion.words.push_back({query_word.is_minus, query_word.is_prefix, query_word.max_distance, {}});
+        }
+        auto& terms = expansion.words[word_index++].terms;
+        const auto add_term = [this, &terms](const std::string_view& term, int distance) {
+            const auto postings_iter = word_to_document_freqs_.find(term);
+            auto& [term_distance, document_count] = terms.try_emplace(std::string(term), distance, 0).first->second;
+            if (postings_iter != word_to_document_freqs_.end()) {
+                document_count += static_cast<int>(postings_iter->second.size());
+            }
+        };
+        if (query_word.is_prefix) {
+            std::pmr::vector<std::string_view> prefix_terms(arena.GetResource());
+            ExpandPrefix(query_word.data, MAX_PREFIX_EXPANSION_COUNT, std::back_inserter(prefix_terms));
+            for (const std::string_view& term : prefix_terms) {
+                add_term(term, 0);
+            }
+        } else if (query_word.max_distance > 0) {
+            ExpandFuzzyWord(query_word.data, query_word.max_distance, MAX_FUZZY_EXPANSION_COUNT, arena.GetResource(),
+                            add_term);
+        } else {
+            add_term(query_word.data, 0);
+        }
+    });
+}
+
+SearchServer::Query SearchServer::ParseExpandedQuery(const QueryExpansion& expansion, CorpusStatistics& statistics,
+                                                     std::pmr::memory_resource* resource) {
+    Query result(resource);
+    statistics.document_count = expansion.document_count;
+    for (const QueryExpansion::Word& word : expansion.words) {
+        // Раскрытие единого сервера — первые по алфавиту слова с префиксом или ближайшие слова с опечаткой;
+        // каждое из них входит и в раскрытие того шарда, в словаре которого есть
+        std::pmr::vector<std::tuple<int, std::string_view, int>> terms(resource);
+        for (const auto& [term, match] : word.terms) {
+            if (match.second > 0) {
+                terms.emplace_back(match.first, term, match.second);
+            }
+        }
+        if (word.is_prefix && terms.size() > static_cast<size_t>(MAX_PREFIX_EXPANSION_COUNT)) {
+            terms.resize(MAX_PREFIX_EXPANSION_COUNT);
+        } else if (word.max_distance > 0 && terms.size() > static_cast<size_t>(MAX_FUZZY_EXPANSION_COUNT)) {
+            std::nth_element(terms.begin(), terms.begin() + MAX_FUZZY_EXPANSION_COUNT, terms.end());
+            terms.resize(MAX_FUZZY_EXPANSION_COUNT);
+        }
+        for (const auto& [distance, term, document_count] : terms) {
+            if (word.is_minus) {
+                result.minus_words.insert(term);
+                continue;
+            }
+            result.AddPlusWord(term, std::pow(FUZZY_DISTANCE_PENALTY, distance));
+            statistics.word_document_counts.emplace(term, document_count);
+        }
+    }
+    return result;
+}
+
+std::vector<Document> SearchServer::FindTopDocuments(const AutoExecutionPolicy& policy, const std::string_view& raw_query,
+                                                     DocumentStatus status) const {
+    if (head_term_cache_ && status == DocumentStatus::ACTUAL) {
+        if (auto documents = FindTopDocumentsInHeadTermCache(raw_query)) {
+            return std::move(*documents);
+        }
+    }
+    return FindTopDocuments(policy, raw_query, [status](int document_id, DocumentStatus document_status, int rating) {
+                            return document_status == status;
+                        });
+}
+
+std::vector<Document> SearchServer::FindTopDocuments(const AutoExecutionPolicy& policy, const std::string_view& raw_query) const {
+    return FindTopDocuments(policy, raw_query, DocumentStatus::ACTUAL);
+}
+
 int SearchServer::GetDocumentCount() const {
     return documents_.size();
 }
@@ -71,11 +271,11 @@ int SearchServer::GetDocumentId(int index) const {
     return document_ids_.at(index);
 }
 
-std::vector<int>::const_iterator SearchServer::begin() const {
+SearchServer::DocumentIds::const_iterator SearchServer::begin() const {
     return this->document_ids_.begin();
 }
 
-std::vector<int>::const_iterator SearchServer::end() const {
+SearchServer::DocumentIds::const_iterator SearchServer::end() const {
     return this->document_ids_.end();
 }
 
@@ -86,6 +286,110 @@ const std::map<std::string_view, double>& SearchServer::GetWordFrequencies(int d
     return (*document_to_word_freqs_.end()).second;
 }
 
+std::vector<std::string_view> SearchServer::GetCompletions(const std::string_view& prefix, int max_count) const {
+    if (!IsValidWord(prefix)) {
+        throw std::invalid_argument("Prefix " + static_cast<std::string>(prefix) + " is invalid");
+    }
+
+    const size_t result_size = static_cast<size_t>(std::max(max_count, 0));
+    const auto to_words = [result_size](const std::vector<Completion>& candidates) {
+        std::vector<std::string_view> completions;
+        completions.reserve(std::min(candidates.size(), result_size));
+        for (size_t i = 0; i < candidates.size() && i < result_size; ++i) {
+            completions.push_back(candidates[i].first);
+        }
+        return completions;
+    };
+    if (prefix.size() > MAX_CACHED_COMPLETION_PREFIX_SIZE || max_count > MAX_CACHED_COMPLETION_COUNT) {
+        return to_words(CollectCompletions(prefix, result_size));
+    }
+
+    {
+        std::shared_lock guard(completion_cache_->mutex);
+        const auto& completions = completion_cache_->completions;
+        if (const auto completions_iter = completions.find(prefix); completions_iter != completions.end()) {
+            return to_words(completions_iter->second);
+        }
+    }
+    // Список собирается без блокировки; если другой поток успел добавить префикс, остаётся его список
+    auto candidates = CollectCompletions(prefix, MAX_CACHED_COMPLETION_COUNT);
+    std::lock_guard guard(completion_cache_->mutex);
+    const auto completions_iter = completion_cache_->completions.emplace(std::string(prefix), std::move(candidates)).first;
+    return to_words(completions_iter->second);
+}
+
+bool SearchServer::IsCompletionBefore(const Completion& lhs, const Completion& rhs) {
+    if (lhs.second != rhs.second) {
+        return lhs.second > rhs.second;
+    }
+    return lhs.first < rhs.first;
+}
+
+std::vector<SearchServer::Completion> SearchServer::CollectCompletions(const std::string_view& prefix,
+                                                                       size_t max_count) const {
+    // Куча лучших слов: в начале худшее из них
+    std::vector<Completion> candidates;
+    if (max_count == 0) {
+        return candidates;
+    }
+    for (auto it = word_to_document_freqs_.lower_bound(prefix); it != word_to_document_freqs_.end(); ++it) {
+        if (it->first.substr(0, prefix.size()) != prefix) {
+            break;
+        }
+        const Completion completion{it->first, it->second.size()};
+        if (candidates.size() < max_count) {
+            candidates.push_back(completion);
+            std::push_heap(candidates.begin(), candidates.end(), IsCompletionBefore);
+        } else if (IsCompletionBefore(completion, candidates.front())) {
+            std::pop_heap(candidates.begin(), candidates.end(), IsCompletionBefore);
+            candidates.back() = completion;
+            std::push_heap(candidates.begin(), candidates.end(), IsCompletionBefore);
+        }
+    }
+    std::sort_heap(candidates.begin(), candidates.end(), IsCompletionBefore);
+    return candidates;
+}
+
+void SearchServer::UpdateCompletionCache(const std::map<std::string_view, double>& word_freqs, bool is_added) {
+    std::lock_guard guard(completion_cache_->mutex);
+    auto& completions = completion_cache_->completions;
+    if (completions.empty()) {
+        return;
+    }
+    for (const auto& [word, _] : word_freqs) {
+        const auto postings_iter = word_to_document_freqs_.find(word);
+        const Completion completion{word, postings_iter == word_to_document_freqs_.end() ? 0 : postings_iter->second.size()};
+        for (size_t prefix_size = 0; prefix_size <= std::min(word.size(), MAX_CACHED_COMPLETION_PREFIX_SIZE); ++prefix_size) {
+            const auto completions_iter = completions.find(word.substr(0, prefix_size));
+            if (completions_iter == completions.end()) {
+                continue;
+            }
+            auto& candidates = completions_iter->second;
+            const auto word_iter = std::find_if(candidates.begin(), candidates.end(), [&word](const Completion& candidate) {
+                return candidate.first == word;
+            });
+            if (!is_added) {
+                // Слово из списка могло опуститься ниже слов, которых в списке нет
+                if (word_iter != candidates.end()) {
+                    completions.erase(completions_iter);
+                }
+                continue;
+            }
+            // Слово, выросшее выше последнего в списке, вытесняет его: остальные слова вне списка шли после него
+            if (word_iter != candidates.end()) {
+                candidates.erase(word_iter);
+            } else if (candidates.size() == static_cast<size_t>(MAX_CACHED_COMPLETION_COUNT)) {
+                if (!IsCompletionBefore(completion, candidates.back())) {
+                    continue;
+                }
+                candidates.pop_back();
+            }
+            candidates.insert(std::upper_bound(candidates.begin(), candidates.end(), completion, IsCompletionBefore),
+                              completion);
+        }
+    }
+}
+
 void SearchServer::RemoveDocument(int document_id) {
     RemoveDocument(std::execution::seq, document_id);
 }
@@ -101,6 +405,9 @@ void SearchServer::RemoveDocument(const std::execution::sequenced_policy& seq_,
             word_to_document_freqs_.erase(word);
         }
     }
+    RemoveFromHeadTermCache(document_id, document_to_word_freqs_.at(document_id));
+    UpdateCompletionCache(document_to_word_freqs_.at(document_id), false);
+    AccountWordFrequencies(document_to_word_freqs_.at(document_id), false);
     document_to_word_freqs_.erase(document_id);
     documents_.erase(document_id);
     document_ids_.erase(std::find(seq_, document_ids_.begin(),document_ids_.end(),document_id));   
@@ -117,19 +424,352 @@ void SearchServer::RemoveDocument(const std::execution::parallel_policy& par_, i
               make_move_iterator(document_to_word_freqs_[document_id].end()),
               delete_.begin());
 
+    //Параллельно меняются только списки документов разных слов; сам словарь word_to_document_freqs_ меняется последовательно
     std::for_each(par_, delete_.begin(), delete_.end(),
                     [&document_id, this](auto& word_ptr) {
-                        word_to_document_freqs_[word_ptr.first].erase(document_id);
-                        if(word_to_document_freqs_[word_ptr.first].empty()) {
-                            word_to_document_freqs_.erase(word_ptr.first);
-                        }
+                        word_to_document_freqs_.find(word_ptr.first)->second.erase(document_id);
                     });
+    for (const auto& [word, _] : delete_) {
+        const auto word_iter = word_to_document_freqs_.find(word);
+        if (word_iter->second.empty()) {
+            word_to_document_freqs_.erase(word_iter);
+        }
+    }
     
     documents_.erase(document_id);
     document_ids_.erase(std::find(document_ids_.begin(), document_ids_.end(), document_id));
+    RemoveFromHeadTermCache(document_id, document_to_word_freqs_.at(document_id));
+    UpdateCompletionCache(document_to_word_freqs_.at(document_id), false);
+    AccountWordFrequencies(document_to_word_freqs_.at(document_id), false);
     document_to_word_freqs_.erase(document_id);
 }
 
+void SearchServer::RemoveDocument(const AutoExecutionPolicy& policy, int document_id) {
+    const auto document_iter = document_to_word_freqs_.find(document_id);
+    if (document_iter != document_to_word_freqs_.end() && HasParallelThreads()
+        && document_iter->second.size() >= execution_calibration_.parallel_threshold_words) {
+        RemoveDocument(std::execution::par, document_id);
+    } else {
+        RemoveDocument(std::execution::seq, document_id);
+    }
+}
+
+void SearchServer::UpdateDocumentStatus(int document_id, DocumentStatus status) {
+    DocumentData& document_data = documents_.at(document_id);
+    StoreDocumentData(document_id, document_data, status, document_data.rating);
+}
+
+void SearchServer::UpdateDocumentRating(int document_id, const std::vector<int>& ratings) {
+    DocumentData& document_data = documents_.at(document_id);
+    StoreDocumentData(document_id, document_data, document_data.status, ComputeAverageRating(ratings));
+}
+
+void SearchServer::UpdateDocumentStatuses(const std::vector<std::pair<int, DocumentStatus>>& updates) {
+    UpdateDocumentStatuses(std::execution::seq, updates);
+}
+
+void SearchServer::UpdateDocumentStatuses(const std::execution::sequenced_policy& seq_,
+                                          const std::vector<std::pair<int, DocumentStatus>>& updates) {
+    std::vector<DocumentData*> documents;
+    documents.reserve(updates.size());
+    for (const auto& [document_id, _] : updates) {
+        documents.push_back(&documents_.at(document_id));
+    }
+    for (size_t i = 0; i < updates.size(); ++i) {
+        StoreDocumentData(updates[i].first, *documents[i], updates[i].second, documents[i]->rating);
+    }
+}
+
+void SearchServer::UpdateDocumentStatuses(const std::execution::parallel_policy& par_,
+                                          const std::vector<std::pair<int, DocumentStatus>>& updates) {
+    // Поиск в documents_ без вставок и удалений безопасен из нескольких потоков
+    std::vector<DocumentData*> documents(updates.size());
+    std::transform(par_, updates.begin(), updates.end(), documents.begin(), [this](const auto& update) {
+        const auto document_iter = documents_.find(update.first);
+        return document_iter == documents_.end() ? nullptr : &document_iter->second;
+    });
+    if (std::find(par_, documents.begin(), documents.end(), nullptr) != documents.end()) {
+        throw std::out_of_range("Out_of_range_id");
+    }
+    // Лучшие документы ускорителя меняются под его блокировкой, поэтому с ним статусы меняются по одному
+    if (head_term_cache_) {
+        for (size_t i = 0; i < updates.size(); ++i) {
+            StoreDocumentData(updates[i].first, *documents[i], updates[i].second, documents[i]->rating);
+        }
+        return;
+    }
+    std::for_each(par_, documents.begin(), documents.end(), [&updates, &documents](DocumentData*& document) {
+        document->status = updates[&document - documents.data()].second;
+    });
+}
+
+void SearchServer::SetExecutionCalibration(const ExecutionCalibration& calibration) {
+    execution_calibration_ = calibration;
+}
+
+const ExecutionCalibration& SearchServer::GetExecutionCalibration() const {
+    return execution_calibration_;
+}
+
+void SearchServer::SetQueryPruning(const QueryPruning& pruning) {
+    if (!(pruning.accuracy > 0.0 && pruning.accuracy <= 1.0)) {
+        throw std::invalid_argument("Pruning accuracy must be in (0, 1]");
+    }
+    if (!(pruning.dynamic_stop_word_ratio > 0.0 && pruning.dynamic_stop_word_ratio <= 1.0)) {
+        throw std::invalid_argument("Dynamic stop word ratio must be in (0, 1]");
+    }
+    query_pruning_ = pruning;
+}
+
+const QueryPruning& SearchServer::GetQueryPruning() const {
+    return query_pruning_;
+}
+
+std::vector<std::string_view> SearchServer::GetDynamicStopWords() const {
+    std::vector<std::string_view> result;
+    for (const auto& [word, _] : word_to_document_freqs_) {
+        if (IsDynamicStopWord(word)) {
+            result.push_back(word);
+        }
+    }
+    return result;
+}
+
+void SearchServer::SetHeadTermCacheSize(size_t term_count) {
+    if (term_count == 0) {
+        head_term_cache_.reset();
+    } else {
+        head_term_cache_ = std::make_unique<HeadTermCache>(term_count);
+    }
+}
+
+HeadTermCacheStats SearchServer::GetHeadTermCacheStats() const {
+    if (!head_term_cache_) {
+        return {};
+    }
+    HeadTermCacheStats stats;
+    {
+        std::shared_lock lock(head_term_cache_->entries_mutex);
+        stats.term_count = head_term_cache_->entries.size();
+    }
+    stats.hit_count = head_term_cache_->hit_count.load(std::memory_order_relaxed);
+    stats.miss_count = head_term_cache_->miss_count.load(std::memory_order_relaxed);
+    return stats;
+}
+
+ExecutionCalibration SearchServer::CalibrateExecution(const std::vector<std::string>& sample_queries) const {
+    ExecutionCalibration calibration = execution_calibration_;
+    // Без второго потока параллельные варианты не бывают быстрее
+    const size_t max_thread_count = std::min<size_t>(PROCESSOR_CORES, GetArenaConcurrency(PROCESSOR_CORES));
+    if (max_thread_count < 2) {
+        calibration.parallel_threshold_postings = std::numeric_limits<size_t>::max();
+        calibration.parallel_threshold_words = std::numeric_limits<size_t>::max();
+        return calibration;
+    }
+
+    // Лучшее из нескольких измерений, чтобы не учитывать прогрев кэшей и пула потоков
+    const auto measure = [](const auto& find) {
+        const int repeat_count = 3;
+        auto best_time = std::chrono::steady_clock::duration::max();
+        for (int i = 0; i < repeat_count; ++i) {
+            const auto start = std::chrono::steady_clock::now();
+            find();
+            best_time = std::min(best_time, std::chrono::steady_clock::now() - start);
+        }
+        return best_time;
+    };
+
+    // Выбор auto_execution для поиска касается обхода списков документов, поэтому замеряется только он
+    const auto is_actual = [](int document_id, DocumentStatus status, int rating) {
+        return status == DocumentStatus::ACTUAL;
+    };
+    struct Sample {
+        size_t posting_count;
+        std::chrono::steady_clock::duration sequential_time;
+        std::chrono::steady_clock::duration parallel_time;
+    };
+    std::vector<Sample> samples;
+    samples.reserve(sample_queries.size());
+    std::vector<size_t> postings_per_thread;
+    for (const std::string& raw_query : sample_queries) {
+        QueryArena arena;
+        const Query query = ParseQuery(raw_query, arena.GetResource());
+        const size_t posting_count = ComputeQueryPostingCount(query);
+        // Параллельный поиск делит между потоками слова, поэтому потоков не больше, чем плюс-слов
+        const size_t thread_limit = std::min(max_thread_count, query.plus_words.size());
+        Sample sample{posting_count, measure([&] { FindAllDocuments(std::execution::seq, query, is_actual); }),
+                      std::chrono::steady_clock::duration::max()};
+        size_t best_thread_count = 1;
+        for (size_t thread_count = 1; thread_count <= thread_limit; ++thread_count) {
+            const auto parallel_time = measure([&] {
+                FindAllDocuments(std::execution::par, query, is_actual, nullptr, nullptr, thread_count);
+            });
+            if (parallel_time < sample.parallel_time) {
+                sample.parallel_time = parallel_time;
+                best_thread_count = thread_count;
+            }
+        }
+        if (thread_limit >= 2 && sample.parallel_time < sample.sequential_time) {
+            postings_per_thread.push_back(posting_count / best_thread_count);
+        }
+        samples.push_back(sample);
+    }
+
+    // Объём на поток — медиана по запросам, которым параллельный поиск помог
+    if (!postings_per_thread.empty()) {
+        const auto median = postings_per_thread.begin() + postings_per_thread.size() / 2;
+        std::nth_element(postings_per_thread.begin(), median, postings_per_thread.end());
+        calibration.postings_per_thread = std::max<size_t>(*median, 1);
+    }
+
+    // Запросы дешевле порога выполняются последовательно, остальные параллельно.
+    // Перебираем все пороги и оставляем тот, при котором суммарное время наименьшее
+    std::sort(samples.begin(), samples.end(), [](const Sample& lhs, const Sample& rhs) {
+        return lhs.posting_count < rhs.posting_count;
+    });
+    auto total_time = std::chrono::steady_clock::duration::zero();
+    for (const Sample& sample : samples) {
+        total_time += sample.parallel_time;
+    }
+    calibration.parallel_threshold_postings = samples.empty() ? calibration.parallel_threshold_postings
+                                                              : samples.front().posting_count;
+    auto best_total_time = total_time;
+    for (size_t i = 0; i < samples.size(); ++i) {
+        total_time += samples[i].sequential_time - samples[i].parallel_time;
+        if (total_time < best_total_time) {
+            best_total_time = total_time;
+            calibration.parallel_threshold_postings = i + 1 < samples.size() ? samples[i + 1].posting_count
+                                                                              : samples[i].posting_count + 1;
+        }
+    }
+
+    // Порог по числу слов подбирается на MatchDocument с запросами из 2, 4, 8, ... слов словаря:
+    // наименьший размер, начиная с которого параллельный вариант не медленнее на всех больших размерах.
+    // RemoveDocument меняет индекс и не замеряется; он использует тот же порог
+    if (!document_ids_.empty() && word_to_document_freqs_.size() >= 2) {
+        const int document_id = document_ids_.front();
+        std::string raw_query;
+        size_t word_count = 0;
+        size_t threshold = std::numeric_limits<size_t>::max();
+        for (auto word_iter = word_to_document_freqs_.begin();
+             word_iter != word_to_document_freqs_.end() && word_count < MAX_CALIBRATION_QUERY_WORD_COUNT; ++word_iter) {
+            if (!raw_query.empty()) {
+                raw_query += ' ';
+            }
+            raw_query += word_iter->first;
+            ++word_count;
+            if ((word_count & (word_count - 1)) != 0) {
+                continue;
+            }
+            const auto sequential_time = measure([&] { MatchDocument(std::execution::seq, raw_query, document_id); });
+            const auto parallel_time = measure([&] { MatchDocument(std::execution::par, raw_query, document_id); });
+            if (parallel_time > sequential_time) {
+                threshold = std::numeric_limits<size_t>::max();
+            } else if (threshold == std::numeric_limits<size_t>::max()) {
+                threshold = word_count;
+            }
+        }
+        calibration.parallel_threshold_words = threshold;
+    }
+    return calibration;
+}
+
+MemoryStats SearchServer::GetMemoryStats() const {
+    const auto& counters = *memory_counters_;
+
+    MemoryStats stats;
+    stats.dictionary_bytes = counters.dictionary.bytes;
+    stats.posting_bytes = counters.postings.bytes;
+    stats.forward_index_bytes = counters.forward_index.bytes;
+    stats.document_metadata_bytes = counters.document_metadata.bytes;
+    stats.allocator_overhead_bytes = counters.dictionary.overhead_bytes + counters.postings.overhead_bytes
+                                   + counters.forward_index.overhead_bytes + counters.document_metadata.overhead_bytes;
+    stats.allocation_count = counters.dictionary.allocations + counters.postings.allocations
+                           + counters.forward_index.allocations + counters.document_metadata.allocations;
+    return stats;
+}
+
+void SearchServer::SetMemoryBudget(size_t max_bytes) {
+    memory_budget_ = max_bytes;
+}
+
+void SearchServer::SaveCheckpoint(std::ostream& output) const {
+    // Документы пишутся в порядке добавления, чтобы сохранить нумерацию GetDocumentId
+    SaveCheckpoint(output, std::vector<int>(document_ids_.begin(), document_ids_.end()));
+}
+
+void SearchServer::SaveCheckpoint(std::ostream& output, const std::vector<int>& document_order) const {
+    // Порядок проверяется до записи, чтобы не оставить в output половину снимка
+    std::set<int> saved_ids(document_order.begin(), document_order.end());
+    if (document_order.size() != documents_.size() || saved_ids.size() != document_order.size()
+        || !std::all_of(saved_ids.begin(), saved_ids.end(), [this](int document_id) {
+               return documents_.count(document_id) > 0;
+           })) {
+        throw std::invalid_argument("Document order must contain every document once");
+    }
+
+    output << std::setprecision(std::numeric_limits<double>::max_digits10);
+    output << "stop_words " << stop_words_.size();
+    for (const std::string_view& stop_word : stop_words_) {
+        output << ' ' << stop_word;
+    }
+    output << '\n';
+
+    output << "documents " << document_order.size() << '\n';
+    for (const int document_id : document_order) {
+        const auto& document_data = documents_.at(document_id);
+        const auto& word_freqs = document_to_word_freqs_.at(document_id);
+        output << document_id << ' ' << static_cast<int>(document_data.status.load()) << ' ' << document_data.rating
+               << ' ' << word_freqs.size();
+        // Перед словом пишется его длина: текст документа может содержать пустые слова
+        for (const auto& [word, term_freq] : word_freqs) {
+            output << ' ' << word.size() << ' ' << word << ' ' << term_freq;
+        }
+        output << '\n';
+    }
+}
+
+SearchServer SearchServer::LoadCheckpoint(std::istream& input) {
+    std::string section;
+    size_t count = 0;
+    if (!(input >> section >> count) || section != "stop_words") {
+        throw std::invalid_argument("Invalid checkpoint");
+    }
+    std::vector<std::string> stop_words(count);
+    for (std::string& stop_word : stop_words) {
+        input >> stop_word;
+    }
+
+    SearchServer search_server(stop_words);
+    if (!(input >> section >> count) || section != "documents") {
+        throw std::invalid_argument("Invalid checkpoint");
+    }
+    for (size_t i = 0; i < count; ++i) {
+        int document_id = 0;
+        int status = 0;
+        int rating = 0;
+        size_t word_count = 0;
+        input >> document_id >> status >> rating >> word_count;
+        std::vector<std::string> words(word_count);
+        std::map<std::string_view, double> word_frequencies;
+        for (std::string& word : words) {
+            size_t word_size = 0;
+            double term_freq = 0.0;
+            input >> word_size;
+            if (word_size > 0) {
+                input >> word;
+            }
+            input >> term_freq;
+            word_frequencies[word] = term_freq;
+        }
+        if (!input) {
+            throw std::invalid_argument("Invalid checkpoint");
+        }
+        search_server.RestoreDocument(document_id, word_frequencies, static_cast<DocumentStatus>(status), rating);
+    }
+    return search_server;
+}
+
 std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDocument(
     const std::string_view& raw_query,
     int document_id) const {
@@ -149,7 +789,8 @@ std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDoc
     throw std::out_of_range("Out_of_range_id");
   }
 
-  const auto query = ParseQuery(raw_query);
+  QueryArena arena;
+  const auto query = ParseQuery(raw_query, arena.GetResource());
   std::vector<std::string_view> matched_words;
   for (const std::string_view& word : query.plus_words) {
     if (document_to_word_freqs_.at(document_id).count(word) == 0) {
@@ -186,20 +827,33 @@ std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDoc
     throw std::out_of_range("Out_of_range_id");
   }
     
+  QueryArena arena;
   std::vector<std::string_view> matched_words;
-  std::vector<std::string_view> vector_plus;
-  std::vector<std::string_view> vector_minus;
+  std::pmr::vector<std::string_view> vector_plus(arena.GetResource());
+  std::pmr::vector<std::string_view> vector_minus(arena.GetResource());
     
-  for (const auto& word : SplitIntoWords(raw_query)) {
+  ForEachWord(raw_query, [&](const std::string_view& word) {
     const auto parse_word = ParseQueryWord(word);
     if (!parse_word.is_stop) {
-        if (parse_word.is_minus) {
-            vector_minus.push_back(move(parse_word.data));
+        auto& words = parse_word.is_minus ? vector_minus : vector_plus;
+        if (parse_word.is_prefix) {
+            ExpandPrefix(parse_word.data, MAX_PREFIX_EXPANSION_COUNT, std::back_inserter(words));
+        } else if (parse_word.max_distance > 0) {
+            ExpandFuzzyWord(parse_word.data, parse_word.max_distance, MAX_FUZZY_EXPANSION_COUNT, arena.GetResource(),
+                            [&words](const std::string_view& term, int) {
+                                words.push_back(term);
+                            });
         } else {
-            vector_plus.push_back(move(parse_word.data));
+            words.push_back(parse_word.data);
         }
     }
-  }
+  });
+
+  vector_plus.erase(std::remove_if(vector_plus.begin(), vector_plus.end(),
+                                  [this](const std::string_view& word) {
+                                      return IsDynamicStopWord(word);
+                                  }),
+                   vector_plus.end());
 
   bool match_minus_words = std::any_of(par_, vector_minus.begin(), vector_minus.end(),
                                         [&](const std::string_view& word) {
@@ -219,8 +873,19 @@ std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDoc
   return {matched_words, SearchServer::documents_.at(document_id).status};
 }
 
+std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDocument(
+    const AutoExecutionPolicy& policy,
+    const std::string_view& raw_query,
+    int document_id) const {
+  const size_t word_count = std::count(raw_query.begin(), raw_query.end(), ' ') + 1;
+  if (word_count >= execution_calibration_.parallel_threshold_words && HasParallelThreads()) {
+    return MatchDocument(std::execution::par, raw_query, document_id);
+  }
+  return MatchDocument(std::execution::seq, raw_query, document_id);
+}
+
 bool SearchServer::IsStopWord(const std::string_view& word) const {
-    return stop_words_.count(word) > 0;
+    return stop_words_.Contains(word);
 }
 
 bool SearchServer::IsValidWord(const std::string_view& word) {
@@ -231,8 +896,9 @@ bool SearchServer::IsValidWord(const std::string_view& word) {
 }
 
 std::vector<std::string_view> SearchServer::SplitIntoWordsNoStop(const std::string_view& text) const {
+    // Проверка слова и отсев стоп-слов выполняются в том же проходе, что и разбиение текста
     std::vector<std::string_view> words;
-    for (const std::string_view& word : SplitIntoWords(text)) {
+    ForEachWord(text, [&words, this](const std::string_view& word) {
         if (!IsValidWord(word)) {
             throw std::invalid_argument("Word " + static_cast<std::string>(word) + " is invalid");
         }
@@ -240,10 +906,413 @@ std::vector<std::string_view> SearchServer::SplitIntoWordsNoStop(const std::stri
         if (!IsStopWord(word)) {
             words.push_back(word);
         }
-    }
+    });
     return words;
 }
 
+const SearchServer::IndexNodeSizes& SearchServer::GetIndexNodeSizes() {
+    using WordFrequencies = std::map<std::string_view, double, std::less<std::string_view>,
+                                     CountingAllocator<std::pair<const std::string_view, double>>>;
+    static const IndexNodeSizes node_sizes{
+        MeasureNodeSize<Dictionary>(),
+        MeasureNodeSize<InvertedIndex>(),
+        MeasureNodeSize<PostingList>(),
+        MeasureNodeSize<ForwardIndex>(),
+        MeasureNodeSize<WordFrequencies>(),
+        MeasureNodeSize<DocumentsMetadata>()
+    };
+    return node_sizes;
+}
+
+void SearchServer::CheckMemoryBudget(const std::vector<std::string_view>& words) const {
+    const auto& node_sizes = GetIndexNodeSizes();
+    size_t required_bytes = GetMallocChunkSize(node_sizes.forward_index) + GetMallocChunkSize(node_sizes.document);
+    if (document_ids_.size() == document_ids_.capacity()) {
+        required_bytes += GetMallocChunkSize((document_ids_.size() + std::max<size_t>(document_ids_.size(), 1)) * sizeof(int));
+    }
+
+    std::vector<std::string_view> unique_words(words);
+    std::sort(unique_words.begin(), unique_words.end());
+    unique_words.erase(std::unique(unique_words.begin(), unique_words.end()), unique_words.end());
+
+    // Строки длиннее буфера короткой строки хранятся в отдельном блоке
+    const size_t short_string_capacity = DictionaryWord().capacity();
+    for (const std::string_view& word : unique_words) {
+        required_bytes += GetMallocChunkSize(node_sizes.posting) + GetMallocChunkSize(node_sizes.word_frequency);
+        if (documents_words.count(word) == 0) {
+            required_bytes += GetMallocChunkSize(node_sizes.dictionary_word);
+            if (word.size() > short_string_capacity) {
+                required_bytes += GetMallocChunkSize(word.size() + 1);
+            }
+        }
+        if (word_to_document_freqs_.count(word) == 0) {
+            required_bytes += GetMallocChunkSize(node_sizes.inverted_index);
+        }
+    }
+
+    if (GetMemoryStats().GetTotalBytes() + required_bytes > memory_budget_) {
+        throw std::length_error("Memory budget exceeded");
+    }
+}
+
+void SearchServer::AccountWordFrequencies(const std::map<std::string_view, double>& word_freqs, bool is_allocated) {
+    const size_t node_size = GetIndexNodeSizes().word_frequency;
+    for (size_t i = 0; i < word_freqs.size(); ++i) {
+        if (is_allocated) {
+            memory_counters_->forward_index.Allocate(node_size);
+        } else {
+            memory_counters_->forward_index.Deallocate(node_size);
+        }
+    }
+}
+
+bool SearchServer::IsHeadTermCandidateBefore(const HeadTermCandidate& lhs, const HeadTermCandidate& rhs) {
+    return std::tie(rhs.term_freq, rhs.rating, lhs.document_id) < std::tie(lhs.term_freq, lhs.rating, rhs.document_id);
+}
+
+SearchServer::HeadTermEntry SearchServer::BuildHeadTermEntry(const PostingList& postings) const {
+    HeadTermEntry entry;
+    for (const auto [document_id, term_freq] : postings) {
+        const DocumentData& document_data = documents_.at(document_id);
+        if (document_data.status == DocumentStatus::ACTUAL) {
+            entry.candidates.push_back({term_freq, document_data.rating, document_id});
+        }
+    }
+    // Берём на один документ больше: он становится границей остальных
+    const size_t sorted_count = std::min(entry.candidates.size(), HEAD_TERM_CANDIDATE_COUNT + 1);
+    std::partial_sort(entry.candidates.begin(), entry.candidates.begin() + sorted_count, entry.candidates.end(),
+                      IsHeadTermCandidateBefore);
+    if (entry.candidates.size() > HEAD_TERM_CANDIDATE_COUNT) {
+        entry.outside = entry.candidates[HEAD_TERM_CANDIDATE_COUNT];
+        for (size_t i = HEAD_TERM_CANDIDATE_COUNT + 1; i < entry.candidates.size(); ++i) {
+            AddOutsideHeadTermCandidate(entry, entry.candidates[i]);
+        }
+        entry.candidates.resize(HEAD_TERM_CANDIDATE_COUNT);
+        entry.candidates.shrink_to_fit();
+    }
+    return entry;
+}
+
+void SearchServer::InsertHeadTermCandidate(HeadTermEntry& entry, const HeadTermCandidate& candidate) {
+    auto& candidates = entry.candidates;
+    if (candidates.size() >= HEAD_TERM_CANDIDATE_COUNT && !IsHeadTermCandidateBefore(candidate, candidates.back())) {
+        AddOutsideHeadTermCandidate(entry, candidate);
+        return;
+    }
+    candidates.insert(std::upper_bound(candidates.begin(), candidates.end(), candidate, IsHeadTermCandidateBefore),
+                      candidate);
+    if (candidates.size() > HEAD_TERM_CANDIDATE_COUNT) {
+        AddOutsideHeadTermCandidate(entry, candidates.back());
+        candidates.pop_back();
+    }
+}
+
+void SearchServer::AddOutsideHeadTermCandidate(HeadTermEntry& entry, const HeadTermCandidate& candidate) {
+    if (candidate.term_freq > entry.outside.term_freq) {
+        entry.lower_term_freq = std::max(entry.lower_term_freq, entry.outside.term_freq);
+        entry.outside = candidate;
+    } else if (candidate.term_freq < entry.outside.term_freq) {
+        entry.lower_term_freq = std::max(entry.lower_term_freq, candidate.term_freq);
+    } else if (IsHeadTermCandidateBefore(candidate, entry.outside)) {
+        entry.outside = candidate;
+    }
+}
+
+bool SearchServer::EraseHeadTermCandidate(HeadTermEntry& entry, const std::string_view& word, int document_id) const {
+    const auto candidate_iter = std::find_if(entry.candidates.begin(), entry.candidates.end(),
+                                             [document_id](const HeadTermCandidate& candidate) {
+                                                 return candidate.document_id == document_id;
+                                             });
+    if (candidate_iter == entry.candidates.end()) {
+        return false;
+    }
+    entry.candidates.erase(candidate_iter);
+    if (entry.outside.term_freq >= 0.0 && entry.candidates.size() < HEAD_TERM_CANDIDATE_COUNT / 2) {
+        entry = BuildHeadTermEntry(word_to_document_freqs_.at(word));
+        return true;
+    }
+    return false;
+}
+
+void SearchServer::AddToHeadTermCache(int document_id, const std::map<std::string_view, double>& word_freqs,
+                                      DocumentStatus status, int rating) {
+    if (!head_term_cache_ || status != DocumentStatus::ACTUAL) {
+        return;
+    }
+    std::unique_lock lock(head_term_cache_->entries_mutex);
+    ++head_term_cache_->entries_version;
+    auto& entries = head_term_cache_->entries;
+    for (const auto& [word, term_freq] : word_freqs) {
+        const auto entry_iter = entries.find(word);
+        if (entry_iter != entries.end()) {
+            InsertHeadTermCandidate(entry_iter->second, {term_freq, rating, document_id});
+        }
+    }
+}
+
+void SearchServer::RemoveFromHeadTermCache(int document_id, const std::map<std::string_view, double>& word_freqs) {
+    if (!head_term_cache_) {
+        return;
+    }
+    std::unique_lock lock(head_term_cache_->entries_mutex);
+    ++head_term_cache_->entries_version;
+    auto& entries = head_term_cache_->entries;
+    for (const auto& [word, _] : word_freqs) {
+        const auto entry_iter = entries.find(word);
+        if (entry_iter == entries.end()) {
+            continue;
+        }
+        if (word_to_document_freqs_.count(word) == 0) {
+            entries.erase(entry_iter);
+        } else {
+            EraseHeadTermCandidate(entry_iter->second, word, document_id);
+        }
+    }
+}
+
+void SearchServer::StoreDocumentData(int document_id, DocumentData& document_data, DocumentStatus status, int rating) {
+    if (!head_term_cache_) {
+        document_data.status = status;
+        document_data.rating = rating;
+        return;
+    }
+    std::unique_lock lock(head_term_cache_->entries_mutex);
+    ++head_term_cache_->entries_version;
+    const bool was_actual = document_data.status == DocumentStatus::ACTUAL;
+    document_data.status = status;
+    document_data.rating = rating;
+    if (!was_actual && status != DocumentStatus::ACTUAL) {
+        return;
+    }
+    auto& entries = head_term_cache_->entries;
+    for (const auto& [word, term_freq] : document_to_word_freqs_.at(document_id)) {
+        const auto entry_iter = entries.find(word);
+        if (entry_iter == entries.end()) {
+            continue;
+        }
+        // Собранный заново список уже учитывает новые статус и рейтинг
+        const bool is_rebuilt = EraseHeadTermCandidate(entry_iter->second, word, document_id);
+        if (!is_rebuilt && status == DocumentStatus::ACTUAL) {
+            InsertHeadTermCandidate(entry_iter->second, {term_freq, rating, document_id});
+        }
+    }
+}
+
+void SearchServer::RecordHeadTermQuery(const std::string_view& word) const {
+    HeadTermCache& cache = *head_term_cache_;
+    // Потоки получают части по кругу при первом запросе
+    static std::atomic<size_t> next_shard_index = 0;
+    thread_local const size_t shard_index = next_shard_index.fetch_add(1, std::memory_order_relaxed)
+                                          % HEAD_TERM_QUERY_COUNT_SHARD_COUNT;
+    HeadTermQueryCounts& shard = cache.query_counts[shard_index];
+    {
+        std::lock_guard lock(shard.mutex);
+        auto count_iter = shard.counts.find(word);
+        if (count_iter == shard.counts.end()) {
+            count_iter = shard.counts.emplace(std::string(word), 0).first;
+        }
+        ++count_iter->second;
+    }
+    cache.recorded_query_count.fetch_add(1, std::memory_order_relaxed);
+}
+
+bool SearchServer::IsHeadTermCacheRefreshDue() const {
+    if (!head_term_cache_) {
+        return false;
+    }
+    const HeadTermCache& cache = *head_term_cache_;
+    return cache.recorded_query_count.load(std::memory_order_relaxed)
+               - cache.refreshed_query_count.load(std::memory_order_relaxed) >= HEAD_TERM_REFRESH_INTERVAL;
+}
+
+void SearchServer::RefreshHeadTermCache() const {
+    if (!head_term_cache_) {
+        return;
+    }
+    HeadTermCache& cache = *head_term_cache_;
+    std::lock_guard refresh_guard(cache.refresh_mutex);
+    cache.refreshed_query_count.store(cache.recorded_query_count.load(std::memory_order_relaxed),
+                                      std::memory_order_relaxed);
+
+    std::map<std::string, uint64_t, std::less<>> query_counts;
+    for (HeadTermQueryCounts& shard : cache.query_counts) {
+        std::lock_guard lock(shard.mutex);
+        for (auto it = shard.counts.begin(); it != shard.counts.end();) {
+            query_counts[it->first] += it->second;
+            // Старые запросы весят меньше новых, а редкие слова со временем забываются
+            it->second /= 2;
+            it = it->second == 0 ? shard.counts.erase(it) : std::next(it);
+        }
+    }
+    std::vector<std::pair<uint64_t, std::string_view>> counts;
+    counts.reserve(query_counts.size());
+    for (const auto& [term, count] : query_counts) {
+        counts.emplace_back(count, term);
+    }
+    const size_t head_term_count = std::min(counts.size(), cache.term_count);
+    std::nth_element(counts.begin(), counts.begin() + head_term_count, counts.end(), std::greater<>());
+    counts.resize(head_term_count);
+
+    // Списки новых слов собираются под разделяемой блокировкой: поиск продолжается, ждут только изменения
+    // статуса и рейтинга. Списки слов, оставшихся в наборе, переиспользуются
+    std::map<std::string, HeadTermEntry, std::less<>> built_entries;
+    uint64_t built_version = 0;
+    {
+        std::shared_lock lock(cache.entries_mutex);
+        for (const auto& [_, term] : counts) {
+            const auto postings_iter = word_to_document_freqs_.find(term);
+            if (postings_iter != word_to_document_freqs_.end() && cache.entries.count(term) == 0) {
+                built_entries.emplace(term, BuildHeadTermEntry(postings_iter->second));
+            }
+        }
+        built_version = cache.entries_version;
+    }
+
+    std::unique_lock lock(cache.entries_mutex);
+    // Списки устарели, если за время сборки изменились документы; тогда они собираются заново
+    const bool is_stale = cache.entries_version != built_version;
+    std::map<std::string, HeadTermEntry, std::less<>> entries;
+    for (const auto& [_, term] : counts) {
+        const auto postings_iter = word_to_document_freqs_.find(term);
+        if (postings_iter == word_to_document_freqs_.end()) {
+            continue;
+        }
+        if (const auto entry_iter = cache.entries.find(term); entry_iter != cache.entries.end()) {
+            entries.emplace(term, std::move(entry_iter->second));
+        } else if (const auto built_iter = built_entries.find(term); built_iter != built_entries.end() && !is_stale) {
+            entries.emplace(term, std::move(built_iter->second));
+        } else {
+            entries.emplace(term, BuildHeadTermEntry(postings_iter->second));
+        }
+    }
+    cache.entries = std::move(entries);
+    ++cache.entries_version;
+}
+
+std::optional<std::vector<Document>> SearchServer::FindTopDocumentsInHeadTermCache(const std::string_view& raw_query) const {
+    // Запрос разбирается без раскрытия слов: запрос с префиксом, опечатками или минус-словом ускоритель
+    // не отвечает, и полный поиск раскроет его один раз
+    std::string_view word;
+    bool is_single_word = true;
+    ForEachWord(raw_query, [&](const std::string_view& text) {
+        if (!is_single_word) {
+            return;
+        }
+        const auto query_word = ParseQueryWord(text);
+        if (query_word.is_stop) {
+            return;
+        }
+        if (query_word.is_minus || query_word.is_prefix || query_word.max_distance > 0) {
+            is_single_word = false;
+        } else if (!IsDynamicStopWord(query_word.data)) {
+            is_single_word = word.empty() || word == query_word.data;
+            word = query_word.data;
+        }
+    });
+    if (!is_single_word || word.empty() || word_to_document_freqs_.count(word) == 0) {
+        return std::nullopt;
+    }
+    RecordHeadTermQuery(word);
+
+    HeadTermCache& cache = *head_term_cache_;
+    std::shared_lock lock(cache.entries_mutex);
+    const auto entry_iter = cache.entries.find(word);
+    if (entry_iter == cache.entries.end()) {
+        cache.miss_count.fetch_add(1, std::memory_order_relaxed);
+        return std::nullopt;
+    }
+    const HeadTermEntry& entry = entry_iter->second;
+    const double inverse_document_freq = ComputeWordInverseDocumentFreq(word);
+    std::vector<Document> matched_documents;
+    matched_documents.reserve(entry.candidates.size());
+    for (const HeadTermCandidate& candidate : entry.candidates) {
+        matched_documents.push_back({candidate.document_id, candidate.term_freq * inverse_document_freq, candidate.rating});
+    }
+    SelectTopDocuments(matched_documents);
+
+    // Документы вне списка с частотой outside.term_freq идут не раньше outside, а документы с меньшей
+    // частотой должны отставать по релевантности больше чем на EPSILON, иначе порядок решал бы рейтинг.
+    // Если выдача из списка не гарантирована, ищем полностью
+    const bool is_complete = entry.outside.term_freq < 0.0;
+    const auto is_certain = [&entry, &matched_documents, inverse_document_freq] {
+        if (matched_documents.size() < MAX_RESULT_DOCUMENT_COUNT) {
+            return false;
+        }
+        const Document& last = matched_documents.back();
+        const Document outside{entry.outside.document_id, entry.outside.term_freq * inverse_document_freq,
+                               entry.outside.rating};
+        return IsRankedBefore(last, outside)
+            && (entry.lower_term_freq < 0.0 || entry.lower_term_freq * inverse_document_freq < last.relevance - EPSILON);
+    };
+    if (!is_complete && !is_certain()) {
+        cache.miss_count.fetch_add(1, std::memory_order_relaxed);
+        return std::nullopt;
+    }
+    cache.hit_count.fetch_add(1, std::memory_order_relaxed);
+    return matched_documents;
+}
+
+SearchServer SearchServer::CreateEmptyCopy() const {
+    SearchServer search_server(stop_words_);
+    search_server.memory_budget_ = memory_budget_;
+    search_server.execution_calibration_ = execution_calibration_;
+    search_server.query_pruning_ = query_pruning_;
+    if (head_term_cache_) {
+        search_server.SetHeadTermCacheSize(head_term_cache_->term_count);
+    }
+    return search_server;
+}
+
+SearchServer SearchServer::RenumberDocuments(const std::vector<int>& document_order) const {
+    if (document_order.size() != documents_.size()) {
+        throw std::invalid_argument("Document order must contain every document once");
+    }
+    SearchServer search_server = CreateEmptyCopy();
+    std::set<int> renumbered_ids;
+    for (size_t i = 0; i < document_order.size(); ++i) {
+        const int document_id = document_order[i];
+        const auto document_iter = documents_.find(document_id);
+        if (document_iter == documents_.end() || !renumbered_ids.insert(document_id).second) {
+            throw std::invalid_argument("Document order must contain every document once");
+        }
+        search_server.RestoreDocument(static_cast<int>(i), document_to_word_freqs_.at(document_id),
+                                      document_iter->second.status, document_iter->second.rating);
+    }
+    return search_server;
+}
+
+void SearchServer::RestoreDocument(int document_id, const std::map<std::string_view, double>& word_frequencies,
+                                   DocumentStatus status, int rating) {
+    if ((document_id < 0) || (documents_.count(document_id) > 0)) {
+        throw std::invalid_argument("Invalid document_id");
+    }
+    if (memory_budget_ > 0) {
+        std::vector<std::string_view> words;
+        words.reserve(word_frequencies.size());
+        for (const auto& [word, _] : word_frequencies) {
+            words.push_back(word);
+        }
+        CheckMemoryBudget(words);
+    }
+
+    const PostingList::allocator_type posting_allocator(&memory_counters_->postings);
+    auto& word_freqs = document_to_word_freqs_[document_id];
+    for (const auto& [word, term_freq] : word_frequencies) {
+        auto word_iter = documents_words.find(word);
+        if (word_iter == documents_words.end()) {
+            word_iter = documents_words.emplace(word.data(), word.size(), documents_words.get_allocator()).first;
+        }
+        const std::string_view word_view{*(word_iter)};
+        word_to_document_freqs_.try_emplace(word_view, posting_allocator).first->second[document_id] = term_freq;
+        word_freqs[word_view] = term_freq;
+    }
+    AccountWordFrequencies(word_freqs, true);
+    documents_.try_emplace(document_id, rating, status);
+    AddToHeadTermCache(document_id, word_freqs, status, rating);
+    UpdateCompletionCache(word_freqs, true);
+    document_ids_.push_back(document_id);
+}
+
 int SearchServer::ComputeAverageRating(const std::vector<int>& ratings) {
     if (ratings.empty()) {
         return 0;
@@ -264,34 +1333,156 @@ SearchServer::QueryWord SearchServer::ParseQueryWord(const std::string_view& tex
         word = word.substr(1);
     }
 
+    // Слово вида cat* задаёт префикс и раскрывается в слова словаря с этим префиксом
+    bool is_prefix = false;
+    if (!word.empty() && word.back() == '*') {
+        is_prefix = true;
+        word.remove_suffix(1);
+    }
+
+    // Слово вида cat~ или cat~2 ищется с опечатками: с расстоянием редактирования до 1 или до 2
+    int max_distance = 0;
+    const size_t tilde_pos = word.rfind('~');
+    const std::string_view distance = tilde_pos == std::string_view::npos ? std::string_view() : word.substr(tilde_pos + 1);
+    if (!is_prefix && tilde_pos != std::string_view::npos
+        && std::all_of(distance.begin(), distance.end(), [](char c) { return c >= '0' && c <= '9'; })) {
+        if (distance.empty()) {
+            max_distance = 1;
+        } else if (distance.size() == 1 && distance[0] >= '1' && distance[0] <= '0' + MAX_FUZZY_DISTANCE) {
+            max_distance = distance[0] - '0';
+        } else {
+            throw std::invalid_argument("Query word " + static_cast<std::string>(text) + " has invalid edit distance");
+        }
+        word = word.substr(0, tilde_pos);
+    }
+
     if (word.empty() || word[0] == '-' || !IsValidWord(word)) {
         throw std::invalid_argument("Query word " + static_cast<std::string>(text) + " is invalid");
     }
     
-    return {word, is_minus, IsStopWord(word)};
+    const bool is_exact = !is_prefix && max_distance == 0;
+    return {word, is_minus, is_exact && IsStopWord(word), is_prefix, max_distance};
 }
 
    
-SearchServer::Query SearchServer::ParseQuery(const std::string_view& text) const {
-    Query result;
-    for (const std::string_view& word : SplitIntoWords(text)) {
+SearchServer::Query SearchServer::ParseQuery(const std::string_view& text, std::pmr::memory_resource* resource) const {
+    Query result(resource);
+    const auto add_word = [&result, this](bool is_minus, const std::string_view& word, double weight) {
+        if (is_minus) {
+            result.minus_words.insert(word);
+        } else if (!IsDynamicStopWord(word)) {
+            result.AddPlusWord(word, weight);
+        }
+    };
+    ForEachWord(text, [&](const std::string_view& word) {
         const auto query_word = ParseQueryWord(word);
-        if (!query_word.is_stop) {
-            if (query_word.is_minus) {
-                result.minus_words.insert(query_word.data);
-            } else {
-                result.plus_words.insert(query_word.data);
+        if (query_word.is_stop) {
+            return;
+        }
+        if (query_word.is_prefix) {
+            std::pmr::vector<std::string_view> terms(resource);
+            ExpandPrefix(query_word.data, MAX_PREFIX_EXPANSION_COUNT, std::back_inserter(terms));
+            for (const std::string_view& term : terms) {
+                add_word(query_word.is_minus, term, 1.0);
             }
+        } else if (query_word.max_distance > 0) {
+            ExpandFuzzyWord(query_word.data, query_word.max_distance, MAX_FUZZY_EXPANSION_COUNT, resource,
+                            [&](const std::string_view& term, int distance) {
+                                add_word(query_word.is_minus, term, std::pow(FUZZY_DISTANCE_PENALTY, distance));
+                            });
+        } else {
+            add_word(query_word.is_minus, query_word.data, 1.0);
         }
-    }
+    });
     return result;
 }
 
+bool SearchServer::IsDynamicStopWord(const std::string_view& word) const {
+    if (query_pruning_.dynamic_stop_word_ratio >= 1.0) {
+        return false;
+    }
+    const auto word_iter = word_to_document_freqs_.find(word);
+    return word_iter != word_to_document_freqs_.end()
+           && word_iter->second.size() > query_pruning_.dynamic_stop_word_ratio * GetDocumentCount();
+}
+
+void SearchServer::TopRelevanceTracker::UpdateMinIndex() {
+    min_index_ = 0;
+    for (size_t i = 1; i < size_; ++i) {
+        if (top_documents_[i].second < top_documents_[min_index_].second) {
+            min_index_ = i;
+        }
+    }
+}
+
+size_t SearchServer::ComputeQueryPostingCount(const Query& query) const {
+    size_t posting_count = 0;
+    for (const auto& words : {&query.plus_words, &query.minus_words}) {
+        for (const std::string_view& word : *words) {
+            const auto word_iter = word_to_document_freqs_.find(word);
+            if (word_iter != word_to_document_freqs_.end()) {
+                posting_count += word_iter->second.size();
+            }
+        }
+    }
+    return posting_count;
+}
+
+SearchServer::ExecutionPlan SearchServer::PlanExecution(const Query& query) const {
+    // Параллельный поиск распределяет по потокам плюс-слова, поэтому одно слово выгоднее обработать последовательно
+    const size_t posting_count = ComputeQueryPostingCount(query);
+    if (query.plus_words.size() < 2 || posting_count < execution_calibration_.parallel_threshold_postings
+        || !HasParallelThreads()) {
+        return {false, 1};
+    }
+    return {true, ComputeThreadCount(query, posting_count)};
+}
+
+size_t SearchServer::ComputeThreadCount(const Query& query, size_t posting_count) const {
+    const size_t thread_count = posting_count / std::max<size_t>(execution_calibration_.postings_per_thread, 1);
+    return std::clamp<size_t>(thread_count, 1, std::max<size_t>(std::min<size_t>(PROCESSOR_CORES, query.plus_words.size()), 1));
+}
+
+bool SearchServer::HasParallelThreads() {
+    return tbb::this_task_arena::max_concurrency() > 1;
+}
+
+int SearchServer::GetArenaConcurrency(size_t thread_count) {
+    const size_t max_concurrency = static_cast<size_t>(tbb::this_task_arena::max_concurrency());
+    return static_cast<int>(std::clamp<size_t>(thread_count, 1, max_concurrency));
+}
+
 // Existence required
 double SearchServer::ComputeWordInverseDocumentFreq(const std::string_view& word) const {
     return std::log(GetDocumentCount() * 1.0 / word_to_document_freqs_.at(word).size());
 }   
 
+double SearchServer::ComputeWordInverseDocumentFreq(const std::string_view& word, const CorpusStatistics* statistics) const {
+    if (statistics == nullptr) {
+        return ComputeWordInverseDocumentFreq(word);
+    }
+    const auto word_iter = statistics->word_document_counts.find(word);
+    if (word_iter == statistics->word_document_counts.end()) {
+        return ComputeWordInverseDocumentFreq(word);
+    }
+    return std::log(statistics->document_count * 1.0 / word_iter->second);
+}
+
+
+bool SearchServer::IsRankedBefore(const Document& lhs, const Document& rhs) {
+    if (std::abs(lhs.relevance - rhs.relevance) >= EPSILON) {
+        return lhs.relevance > rhs.relevance;
+    }
+    if (lhs.rating != rhs.rating) {
+        return lhs.rating > rhs.rating;
+    }
+    return lhs.id < rhs.id;
+}
+
+bool SearchServer::IsPagedBefore(const Document& lhs, const Document& rhs) {
+    return std::tie(rhs.relevance, rhs.rating, lhs.id) < std::tie(lhs.relevance, lhs.rating, rhs.id);
+}
+
     
 void AddDocument(SearchServer& search_server, int document_id, const std::string_view& document, DocumentStatus status,
                  const std::vector<int>& ratings) {
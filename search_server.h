@@ -1,4 +1,5 @@
 #pragma once
+#include <array>
 #include <iostream>
 #include <set>
 #include <string>
@@ -9,6 +10,13 @@
 #include <tuple>
 #include <exception>
 #include <cmath>
+#include <memory>
+#include <chrono>
+#include <atomic>
+#include <limits>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
 #include "string_processing.h"
 #include "document.h"
 #include "log_duration.h"
@@ -16,22 +24,166 @@
 #include <string_view>
 #include <type_traits>
 #include <execution>
+#include <tbb/task_arena.h>
 #include "log_duration.h"
 #include "concurrent_map.h"
+#include "memory_accounting.h"
+#include "query_arena.h"
+#include "perfect_hash_set.h"
+#include "levenshtein_automaton.h"
+#include "search_deadline.h"
 
 const int PROCESSOR_CORES = 4;
 const int MAX_RESULT_DOCUMENT_COUNT = 5;
 const double EPSILON = 1e-6;
+// Сколько слов словаря подставляется вместо слова с префиксом. Минус-слово с префиксом исключает
+// документы только этих слов, как и плюс-слово находит только их
+const int MAX_PREFIX_EXPANSION_COUNT = 64;
+const int MAX_FUZZY_DISTANCE = 2;
+const int MAX_FUZZY_EXPANSION_COUNT = 64;
+// Сколько лучших дополнений хранится для префикса; GetCompletions с большим max_count обходит слова префикса
+const int MAX_CACHED_COMPLETION_COUNT = 16;
+// Дополнения хранятся для префиксов не длиннее этого: у длинных префиксов мало слов, и обход словаря дёшев
+const size_t MAX_CACHED_COMPLETION_PREFIX_SIZE = 4;
+// Вклад слова, найденного на расстоянии d от слова запроса, умножается на FUZZY_DISTANCE_PENALTY^d
+const double FUZZY_DISTANCE_PENALTY = 0.5;
+// Сколько запросов FindTopDocumentsBatch обрабатывает за один общий обход списков документов
+const size_t BATCH_PART_QUERY_COUNT = 256;
+// Наибольшее число слов запроса, на котором CalibrateExecution замеряет MatchDocument
+const size_t MAX_CALIBRATION_QUERY_WORD_COUNT = 4096;
+// Через сколько записей списков документов поиск с дедлайном снова проверяет время
+const size_t DEADLINE_CHECK_INTERVAL = 256;
+// Сколько документов с наибольшей частотой хранит ускоритель однословных запросов для каждого слова
+const size_t HEAD_TERM_CANDIDATE_COUNT = 4 * MAX_RESULT_DOCUMENT_COUNT;
+// Через сколько однословных запросов ускоритель пересматривает набор слов по частотам запросов
+const uint64_t HEAD_TERM_REFRESH_INTERVAL = 1024;
+// На сколько частей делятся частоты однословных запросов, чтобы потоки поиска не ждали друг друга
+const size_t HEAD_TERM_QUERY_COUNT_SHARD_COUNT = 16;
+
+// Статистика коллекции, по которой вычисляется IDF. Позволяет нескольким серверам (шардам)
+// ранжировать документы так же, как единый сервер со всеми документами
+struct CorpusStatistics {
+    int document_count = 0;
+    std::map<std::string, int, std::less<>> word_document_counts;
+};
+
+// Слова запроса, раскрытые по словарям нескольких серверов (шардов). Каждый шард добавляет в неё
+// подходящие слова своего словаря (CollectQueryExpansion), после чего все шарды ищут по одному набору слов,
+// отобранному так же, как его отобрал бы единый сервер
+struct QueryExpansion {
+    struct Word {
+        bool is_minus = false;
+        bool is_prefix = false;
+        int max_distance = 0;
+        // Слово словаря -> (расстояние до слова запроса, число документов со словом во всех шардах)
+        std::map<std::string, std::pair<int, int>, std::less<>> terms;
+    };
+
+    int document_count = 0;
+    std::vector<Word> words;    // в порядке слов запроса, без стоп-слов
+};
+
+// Политика выполнения, при которой сервер сам выбирает последовательный или параллельный вариант
+struct AutoExecutionPolicy {
+};
+
+inline constexpr AutoExecutionPolicy auto_execution{};
+
+// Отсечение слов запроса при поиске лучших документов
+struct QueryPruning {
+    // Слова с наименьшим IDF не обходятся целиком, если их суммарный вклад уже не может изменить
+    // MAX_RESULT_DOCUMENT_COUNT лучших документов; их частоты ищутся только у оставшихся кандидатов
+    bool enabled = false;
+    // Доля наибольшего возможного вклада отсекаемых слов, которую учитывает проверка, из (0, 1].
+    // При 1 выдача совпадает с поиском без отсечения, меньшие значения отсекают раньше ценой точности
+    double accuracy = 1.0;
+    // Плюс-слова, встречающиеся в большей доле документов, отбрасываются как стоп-слова, из (0, 1].
+    // Доля вычисляется по текущему индексу, поэтому список меняется вместе с документами. 1 — не отбрасывать
+    double dynamic_stop_word_ratio = 1.0;
+};
+
+// Результат поиска с дедлайном. Если поиск прерван (is_partial), documents — лучшие из документов,
+// набравших релевантность до прерывания; минус-слова при этом учтены полностью
+struct SearchResult {
+    std::vector<Document> documents;
+    bool is_partial = false;
+};
+
+// Позиция постраничной выдачи, создаётся SearchServer::CreateSearchCursor. Хранит слова запроса,
+// раскрытые при создании, с весами по IDF того момента, поэтому релевантность документа на всех страницах
+// вычисляется одинаково и позиция не сдвигается, если между страницами документы добавлялись или удалялись
+class SearchCursor {
+private:
+    friend class SearchServer;
+
+    struct Term {
+        std::string word;
+        double weight;
+    };
+
+    struct Terms {
+        std::vector<Term> plus_terms;    // в порядке слов запроса, как их суммирует FindTopDocuments
+        std::vector<std::string> minus_words;
+    };
+
+    SearchCursor() = default;
+
+    std::shared_ptr<const Terms> terms_;
+    // Последний документ выданных страниц; nullopt — страниц ещё не было
+    std::optional<Document> last_document_;
+};
+
+// Страница выдачи и курсор следующей. Пустая страница означает конец выдачи
+struct SearchPage {
+    std::vector<Document> documents;
+    SearchCursor next;
+};
+
+// Состояние ускорителя однословных запросов
+struct HeadTermCacheStats {
+    size_t term_count = 0;           // слов с готовыми лучшими документами
+    uint64_t hit_count = 0;          // однословных запросов, отвеченных ускорителем
+    uint64_t miss_count = 0;         // однословных запросов, выполненных полным поиском
+};
+
+// Пороги выбора варианта выполнения. Значения по умолчанию — осторожная оценка, а не замер: с ними
+// параллельно выполняются только заведомо тяжёлые запросы и документы. Выгода параллельного варианта
+// зависит от машины, поэтому пороги на целевой машине подбирает CalibrateExecution, а задаёт
+// SetExecutionCalibration. Если процессу доступен один поток, auto_execution всегда выбирает последовательный вариант
+struct ExecutionCalibration {
+    // Суммарная длина списков документов слов запроса, начиная с которой параллельный поиск быстрее
+    size_t parallel_threshold_postings = 100000;
+    // Объём списков документов на один поток параллельного поиска
+    size_t postings_per_thread = 30000;
+    // Число слов запроса (для MatchDocument) или документа (для RemoveDocument), начиная с которого
+    // выгоден параллельный вариант
+    size_t parallel_threshold_words = 1000;
+};
 
 class SearchServer {
 public:
+    // Id документов в порядке добавления; память учитывается в document_metadata_bytes
+    using DocumentIds = std::vector<int, CountingAllocator<int>>;
+
     template <typename StringContainer>
     SearchServer(const StringContainer& stop_words);
+
+    // Стоп-слова из таблицы, построенной при компиляции MakePerfectHashTable; сервер хранит их копию
+    template <size_t N>
+    explicit SearchServer(const PerfectHashTable<N>& stop_words);
+
+    explicit SearchServer(PerfectHashSet stop_words);
    
     explicit SearchServer(const std::string_view& stop_words_text);
     
     explicit SearchServer(const std::string& stop_words_text);    
 
+    // Копия строит свой индекс по частотам слов документов, как RenumberDocuments, с теми же id.
+    // Настройки поиска переносятся, кеши копии начинают пустыми
+    SearchServer(const SearchServer& other);
+
+    SearchServer(SearchServer&& other) = default;
+
     void AddDocument(int document_id, const std::string_view& document, DocumentStatus status, const std::vector<int>& ratings);
 
     template <typename DocumentPredicate>
@@ -58,14 +210,97 @@ public:
     std::vector<Document> FindTopDocuments(const std::execution::sequenced_policy& seq_, const std::string_view& raw_query) const;
 
     std::vector<Document> FindTopDocuments(const std::execution::parallel_policy& par_, const std::string_view& raw_query) const;
-    
+
+    template <typename DocumentPredicate>
+    std::vector<Document> FindTopDocuments(const AutoExecutionPolicy& policy, const std::string_view& raw_query,
+                                           DocumentPredicate document_predicate) const;
+
+    std::vector<Document> FindTopDocuments(const AutoExecutionPolicy& policy, const std::string_view& raw_query,
+                                           DocumentStatus status) const;
+
+    std::vector<Document> FindTopDocuments(const AutoExecutionPolicy& policy, const std::string_view& raw_query) const;
+
+    // Пачка запросов: список документов каждого слова проходится один раз для всех запросов части пачки
+    // (BATCH_PART_QUERY_COUNT запросов), в которых оно встречается; память части освобождается перед следующей.
+    // С включённым отсечением слов запросы ищутся по отдельности. Результат совпадает с FindTopDocuments
+    // для каждого запроса
+    template <typename DocumentPredicate>
+    std::vector<std::vector<Document>> FindTopDocumentsBatch(const std::vector<std::string_view>& raw_queries,
+                                                             DocumentPredicate document_predicate) const;
+
+    std::vector<std::vector<Document>> FindTopDocumentsBatch(const std::vector<std::string_view>& raw_queries,
+                                                             DocumentStatus status) const;
+
+    std::vector<std::vector<Document>> FindTopDocumentsBatch(const std::vector<std::string_view>& raw_queries) const;
+
+    // Ранжирование по внешней статистике коллекции вместо статистики этого сервера
+    template <typename ExecutionPolicy, typename DocumentPredicate>
+    std::vector<Document> FindTopDocuments(const ExecutionPolicy& policy, const std::string_view& raw_query,
+                                           DocumentPredicate document_predicate, const CorpusStatistics& statistics) const;
+
+    // Поиск по копии из RenumberDocuments: документ с id i назывался в исходном индексе original_ids[i].
+    // Id найденных документов заменяются на исходные до выбора лучших, поэтому документы с равными
+    // релевантностью и рейтингом упорядочены и отобраны, как в исходном индексе. Предикат получает id копии.
+    // Отсечение слов не применяется: оно отбрасывало бы документы с равной релевантностью по id копии
+    template <typename ExecutionPolicy, typename DocumentPredicate>
+    std::vector<Document> FindTopDocuments(const ExecutionPolicy& policy, const std::string_view& raw_query,
+                                           DocumentPredicate document_predicate, const std::vector<int>& original_ids) const;
+
+    // Поиск, который по истечении deadline прекращает обход списков документов и возвращает лучшее из найденного
+    template <typename ExecutionPolicy, typename DocumentPredicate>
+    SearchResult FindTopDocuments(const ExecutionPolicy& policy, const std::string_view& raw_query,
+                                  DocumentPredicate document_predicate, const SearchDeadline& deadline) const;
+
+    template <typename ExecutionPolicy>
+    SearchResult FindTopDocuments(const ExecutionPolicy& policy, const std::string_view& raw_query,
+                                  DocumentStatus status, const SearchDeadline& deadline) const;
+
+    SearchResult FindTopDocuments(const std::execution::sequenced_policy& seq_, const std::string_view& raw_query,
+                                  const SearchDeadline& deadline) const;
+
+    SearchResult FindTopDocuments(const std::execution::parallel_policy& par_, const std::string_view& raw_query,
+                                  const SearchDeadline& deadline) const;
+
+    SearchResult FindTopDocuments(const AutoExecutionPolicy& policy, const std::string_view& raw_query,
+                                  const SearchDeadline& deadline) const;
+
+    // Число запросов с дедлайном, прерванных до завершения
+    uint64_t GetTruncatedQueryCount() const;
+
+    // Добавляет в statistics число документов сервера и документные частоты плюс-слов запроса
+    void CollectQueryStatistics(const std::string_view& raw_query, CorpusStatistics& statistics) const;
+
+    // Добавляет в expansion число документов сервера и слова его словаря, подходящие под слова запроса.
+    // Для слов с префиксом или опечаткой добавляются только те, что могут войти в раскрытие
+    // единого сервера: MAX_PREFIX_EXPANSION_COUNT первых и MAX_FUZZY_EXPANSION_COUNT ближайших
+    void CollectQueryExpansion(const std::string_view& raw_query, QueryExpansion& expansion) const;
+
+    // Поиск по словам, раскрытым по всем шардам, с IDF по документным частотам всех шардов
+    template <typename ExecutionPolicy, typename DocumentPredicate>
+    std::vector<Document> FindTopDocuments(const ExecutionPolicy& policy, const QueryExpansion& expansion,
+                                           DocumentPredicate document_predicate) const;
+
+    // Курсор перед первой страницей выдачи запроса
+    SearchCursor CreateSearchCursor(const std::string_view& raw_query) const;
+
+    // Страница выдачи после cursor. Документы обходятся по возрастанию id сразу по спискам всех слов курсора,
+    // и в куче остаются только MAX_RESULT_DOCUMENT_COUNT лучших, ранжированных после курсора.
+    // Страницы упорядочены по точной релевантности, затем рейтингу и id (IsPagedBefore): в отличие от
+    // IsRankedBefore этот порядок транзитивен, и граница страниц не зависит от погрешности EPSILON
+    template <typename DocumentPredicate>
+    SearchPage FindTopDocumentsAfter(const SearchCursor& cursor, DocumentPredicate document_predicate) const;
+
+    SearchPage FindTopDocumentsAfter(const SearchCursor& cursor, DocumentStatus status) const;
+
+    SearchPage FindTopDocumentsAfter(const SearchCursor& cursor) const;
+
     int GetDocumentCount() const;
 
     int GetDocumentId(int index) const;
 
-    std::vector<int>::const_iterator begin() const;
+    DocumentIds::const_iterator begin() const;
 
-    std::vector<int>::const_iterator end() const;
+    DocumentIds::const_iterator end() const;
 
     std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(const std::string_view& raw_query, int document_id) const;
     
@@ -75,26 +310,230 @@ public:
     std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(const std::execution::parallel_policy& par_,
                                                                             const std::string_view& raw_query, int document_id) const;
 
+    std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(const AutoExecutionPolicy& policy,
+                                                                            const std::string_view& raw_query, int document_id) const;
+
     const std::map<std::string_view, double>& GetWordFrequencies(int document_id) const;
 
+    // Слова словаря с заданным префиксом, не более max_count, по убыванию числа содержащих их документов.
+    // Для префиксов не длиннее MAX_CACHED_COMPLETION_PREFIX_SIZE и max_count <= MAX_CACHED_COMPLETION_COUNT
+    // ответ берётся из кеша дополнений под разделяемой блокировкой. Иначе обходятся все слова с префиксом
+    // за O(k log max_count), где k — их число, без кеша. Безопасен при одновременных поисках
+    std::vector<std::string_view> GetCompletions(const std::string_view& prefix, int max_count) const;
+
     void RemoveDocument(int document_id);
     
     void RemoveDocument(const std::execution::sequenced_policy& seq_, int document_id);
     
     void RemoveDocument(const std::execution::parallel_policy& par_, int document_id);
 
+    void RemoveDocument(const AutoExecutionPolicy& policy, int document_id);
+
+    // Меняют статус или рейтинг документа на месте, не затрагивая индекс слов, за O(log n).
+    // Безопасны при одновременных поисках и MatchDocument, но не при AddDocument и RemoveDocument.
+    // Для неизвестного id бросают std::out_of_range
+    void UpdateDocumentStatus(int document_id, DocumentStatus status);
+
+    void UpdateDocumentRating(int document_id, const std::vector<int>& ratings);
+
+    // Пакетное изменение статусов. Все id проверяются до первого изменения: если какого-то документа нет,
+    // бросается std::out_of_range и статусы не меняются
+    void UpdateDocumentStatuses(const std::vector<std::pair<int, DocumentStatus>>& updates);
+
+    void UpdateDocumentStatuses(const std::execution::sequenced_policy& seq_,
+                                const std::vector<std::pair<int, DocumentStatus>>& updates);
+
+    void UpdateDocumentStatuses(const std::execution::parallel_policy& par_,
+                                const std::vector<std::pair<int, DocumentStatus>>& updates);
+
+    void SetExecutionCalibration(const ExecutionCalibration& calibration);
+
+    const ExecutionCalibration& GetExecutionCalibration() const;
+
+    void SetQueryPruning(const QueryPruning& pruning);
+
+    const QueryPruning& GetQueryPruning() const;
+
+    // Слова, которые при текущих документах отбрасываются как динамические стоп-слова
+    std::vector<std::string_view> GetDynamicStopWords() const;
+
+    // Ускоритель однословных запросов со статусом по умолчанию (ACTUAL): для term_count слов, чаще всего
+    // встречающихся в таких запросах, хранятся документы с наибольшей частотой, и запрос отвечается за O(K)
+    // без обхода списка документов. Поиск только считает запросы; набор слов пересматривает RefreshHeadTermCache.
+    // Лучшие документы обновляются при добавлении и удалении документов и изменении их статуса
+    // и рейтинга. Выдача совпадает с полным поиском:
+    // если сохранённых документов не хватает для уверенного ответа, выполняется полный поиск. 0 — выключить
+    void SetHeadTermCacheSize(size_t term_count);
+
+    HeadTermCacheStats GetHeadTermCacheStats() const;
+
+    // С прошлого пересмотра набора слов ускорителя накопилось HEAD_TERM_REFRESH_INTERVAL однословных запросов
+    bool IsHeadTermCacheRefreshDue() const;
+
+    // Пересматривает набор слов ускорителя по частотам запросов и собирает лучшие документы новых слов за O(df).
+    // Вызывается вне пути запроса (например, отдельной задачей, когда IsHeadTermCacheRefreshDue), одновременно
+    // с поиском, но не с добавлением и удалением документов. Поиск ждёт только замены готового набора
+    void RefreshHeadTermCache() const;
+
+    // Подбирает все поля ExecutionCalibration. Обход списков документов sample_queries (без ускорителя
+    // однословных запросов и отсечения слов) замеряется последовательно и параллельно с разным числом потоков:
+    // порог выбирается по наименьшему суммарному времени, объём на поток — по лучшему числу потоков.
+    // Порог по числу слов замеряется на MatchDocument с запросами из слов словаря (до
+    // MAX_CALIBRATION_QUERY_WORD_COUNT). Без второго доступного потока пороги не достигаются
+    ExecutionCalibration CalibrateExecution(const std::vector<std::string>& sample_queries) const;
+
+    // Память, занимаемая индексом, с разбивкой по структурам. Байты контейнеров индекса считают их аллокаторы;
+    // только узлы словарей частот документа (тип которых виден через GetWordFrequencies) учитываются
+    // вручную по измеренному размеру узла. allocator_overhead_bytes — оценка по модели glibc malloc
+    MemoryStats GetMemoryStats() const;
+
+    // Ограничение памяти индекса в байтах, 0 — без ограничения. Если документ не помещается в бюджет,
+    // AddDocument бросает std::length_error и оставляет индекс без изменений. Бюджет соблюдают и документы,
+    // восстановленные из снимка (RenumberDocuments переносит бюджет в копию)
+    void SetMemoryBudget(size_t max_bytes);
+
+    // Снимок индекса в текстовом виде: стоп-слова и частоты слов каждого документа. Исходные тексты не нужны
+    void SaveCheckpoint(std::ostream& output) const;
+
+    // Снимок с документами в порядке document_order вместо порядка добавления; LoadCheckpoint восстанавливает
+    // документы в этом порядке. document_order должен быть перестановкой id документов, иначе бросается
+    // std::invalid_argument
+    void SaveCheckpoint(std::ostream& output, const std::vector<int>& document_order) const;
+
+    static SearchServer LoadCheckpoint(std::istream& input);
+
+    // Копия индекса, в которой документ document_order[i] получает id i. Частоты слов, статусы, рейтинги
+    // и настройки поиска переносятся без пересчёта. document_order должен быть перестановкой id документов,
+    // иначе бросается std::invalid_argument. Если копия не помещается в бюджет памяти, бросается std::length_error
+    SearchServer RenumberDocuments(const std::vector<int>& document_order) const;
+
+    // Порядок выдачи: по убыванию релевантности, затем рейтинга; id разрешает оставшиеся равенства
+    static bool IsRankedBefore(const Document& lhs, const Document& rhs);
+
+    // Порядок постраничной выдачи: как IsRankedBefore, но релевантности сравниваются точно
+    static bool IsPagedBefore(const Document& lhs, const Document& rhs);
+
+    // Оставляет в matched_documents не более MAX_RESULT_DOCUMENT_COUNT лучших документов в порядке выдачи
+    template <typename Documents>
+    static void SelectTopDocuments(Documents& matched_documents);
+
 private:
+    // Рейтинг и статус меняются на месте во время поисков, поэтому атомарны
     struct DocumentData {
+        DocumentData(int rating = 0, DocumentStatus status = DocumentStatus::ACTUAL)
+            : rating(rating)
+            , status(status) {
+        }
+
+        std::atomic<int> rating;
+        std::atomic<DocumentStatus> status;
+    };
+
+    // Счётчики памяти структур индекса. Лежат в куче, чтобы аллокаторы контейнеров
+    // ссылались на них и после перемещения сервера
+    struct IndexMemoryCounters {
+        MemoryCounter dictionary;
+        MemoryCounter postings;
+        MemoryCounter forward_index;
+        MemoryCounter document_metadata;
+    };
+
+    // Счётчики запросов для мониторинга. Лежат в куче, чтобы сервер оставался перемещаемым
+    struct QueryCounters {
+        std::atomic<uint64_t> truncated = 0;
+    };
+
+    // Слово и число содержащих его документов
+    using Completion = std::pair<std::string_view, size_t>;
+
+    // Лучшие дополнения коротких префиксов в порядке IsCompletionBefore. Префикс попадает в кеш при первом
+    // запросе. Рост числа документов слова меняет список на месте; если же уменьшилось число документов
+    // слова из списка, префикс убирается из кеша и при следующем запросе вычисляется заново.
+    // Лежит в куче, чтобы сервер оставался перемещаемым
+    struct CompletionCache {
+        std::shared_mutex mutex;
+        std::map<std::string, std::vector<Completion>, std::less<>> completions;
+    };
+
+    // Документ слова в ускорителе однословных запросов
+    struct HeadTermCandidate {
+        double term_freq;
         int rating;
-        DocumentStatus status;
+        int document_id;
+    };
+
+    // Лучшие документы ACTUAL со словом по частоте, рейтингу и id и границы остальных таких документов.
+    // IDF у всех документов слова общий, поэтому порядок по релевантности совпадает с порядком по частоте
+    // и не зависит от числа документов. Границы только растут, пока список не собран заново
+    struct HeadTermEntry {
+        std::vector<HeadTermCandidate> candidates;   // в порядке IsHeadTermCandidateBefore
+        // Ни один документ вне списка не идёт раньше outside; term_freq = -1 — других документов нет
+        HeadTermCandidate outside{-1.0, 0, 0};
+        // Наибольшая частота документов вне списка с частотой меньше outside.term_freq, -1 — таких нет
+        double lower_term_freq = -1.0;
+    };
+
+    // Часть частот слов однословных запросов. Поток пишет в свою часть, поэтому её блокировка почти всегда
+    // свободна; выравнивание не даёт частям делить строку кеша
+    struct alignas(64) HeadTermQueryCounts {
+        std::mutex mutex;
+        std::map<std::string, uint64_t, std::less<>> counts;
+    };
+
+    // Лежит в куче, чтобы сервер оставался перемещаемым
+    struct HeadTermCache {
+        explicit HeadTermCache(size_t term_count)
+            : term_count(term_count) {
+        }
+
+        const size_t term_count;
+        std::shared_mutex entries_mutex;
+        std::map<std::string, HeadTermEntry, std::less<>> entries;
+        // Растёт при каждом изменении entries, чтобы пересмотр заметил изменения, пока собирал списки
+        uint64_t entries_version = 0;
+        // Частоты слов однословных запросов; делятся пополам при каждом пересмотре набора слов
+        std::array<HeadTermQueryCounts, HEAD_TERM_QUERY_COUNT_SHARD_COUNT> query_counts;
+        std::atomic<uint64_t> recorded_query_count = 0;
+        // Пересмотры выполняются по одному
+        std::mutex refresh_mutex;
+        std::atomic<uint64_t> refreshed_query_count = 0;
+        std::atomic<uint64_t> hit_count = 0;
+        std::atomic<uint64_t> miss_count = 0;
     };
+
+    // Размеры узлов контейнеров индекса, нужны для оценки памяти под новый документ
+    struct IndexNodeSizes {
+        size_t dictionary_word;
+        size_t inverted_index;
+        size_t posting;
+        size_t forward_index;
+        size_t word_frequency;
+        size_t document;
+    };
+
+    using DictionaryWord = std::basic_string<char, std::char_traits<char>, CountingAllocator<char>>;
+    using Dictionary = std::set<DictionaryWord, std::less<>, CountingAllocator<DictionaryWord>>;
+    using PostingList = std::map<int, double, std::less<int>, CountingAllocator<std::pair<const int, double>>>;
+    using InvertedIndex = std::map<std::string_view, PostingList, std::less<std::string_view>,
+                                   CountingAllocator<std::pair<const std::string_view, PostingList>>>;
+    using ForwardIndex = std::map<int, std::map<std::string_view, double>, std::less<int>,
+                                  CountingAllocator<std::pair<const int, std::map<std::string_view, double>>>>;
+    using DocumentsMetadata = std::map<int, DocumentData, std::less<int>,
+                                       CountingAllocator<std::pair<const int, DocumentData>>>;
     
-    const std::set<std::string, std::less<>> stop_words_;
-    std::set<std::string, std::less<>> documents_words;
-    std::map<std::string_view, std::map<int, double>> word_to_document_freqs_;
-    std::map<int, DocumentData> documents_;
-    std::vector<int> document_ids_;
-    std::map<int, std::map<std::string_view, double>> document_to_word_freqs_;
+    std::unique_ptr<IndexMemoryCounters> memory_counters_;
+    std::unique_ptr<QueryCounters> query_counters_;
+    std::unique_ptr<CompletionCache> completion_cache_;
+    const PerfectHashSet stop_words_;
+    Dictionary documents_words;
+    InvertedIndex word_to_document_freqs_;
+    DocumentsMetadata documents_;
+    DocumentIds document_ids_;
+    ForwardIndex document_to_word_freqs_;
+    size_t memory_budget_ = 0;
+    ExecutionCalibration execution_calibration_;
+    QueryPruning query_pruning_;
+    std::unique_ptr<HeadTermCache> head_term_cache_;
 
     bool IsStopWord(const std::string_view& word) const;
 
@@ -103,35 +542,272 @@ private:
     std::vector<std::string_view> SplitIntoWordsNoStop(const std::string_view& text) const;
 
     static int ComputeAverageRating(const std::vector<int>& ratings);
+
+    // Сервер с теми же стоп-словами и настройками поиска, но без документов
+    SearchServer CreateEmptyCopy() const;
+
+    // Добавляет документ по уже вычисленным частотам слов
+    void RestoreDocument(int document_id, const std::map<std::string_view, double>& word_frequencies,
+                         DocumentStatus status, int rating);
+
+    static const IndexNodeSizes& GetIndexNodeSizes();
+
+    // Бросает std::length_error, если документ из words не помещается в бюджет памяти
+    void CheckMemoryBudget(const std::vector<std::string_view>& words) const;
+
+    // Узлы словарей document_to_word_freqs_ выделяет std::allocator (их тип виден через GetWordFrequencies),
+    // поэтому их память учитывается вручную
+    void AccountWordFrequencies(const std::map<std::string_view, double>& word_freqs, bool is_allocated);
+
+    static bool IsCompletionBefore(const Completion& lhs, const Completion& rhs);
+
+    // Не более max_count лучших слов с префиксом prefix; обходит все слова с этим префиксом,
+    // храня только max_count лучших
+    std::vector<Completion> CollectCompletions(const std::string_view& prefix, size_t max_count) const;
+
+    // Обновляет кеш дополнений после изменения списков документов слов word_freqs
+    void UpdateCompletionCache(const std::map<std::string_view, double>& word_freqs, bool is_added);
+
+    static bool IsHeadTermCandidateBefore(const HeadTermCandidate& lhs, const HeadTermCandidate& rhs);
+
+    HeadTermEntry BuildHeadTermEntry(const PostingList& postings) const;
+
+    static void InsertHeadTermCandidate(HeadTermEntry& entry, const HeadTermCandidate& candidate);
+
+    // Расширяет границы документов вне списка на candidate
+    static void AddOutsideHeadTermCandidate(HeadTermEntry& entry, const HeadTermCandidate& candidate);
+
+    // Убирает документ из списка слова. Если в списке осталось мало документов, собирает его заново
+    // по текущему индексу и возвращает true
+    bool EraseHeadTermCandidate(HeadTermEntry& entry, const std::string_view& word, int document_id) const;
+
+    // Обновляют лучшие документы слов ускорителя; вызываются после изменения списков документов
+    void AddToHeadTermCache(int document_id, const std::map<std::string_view, double>& word_freqs,
+                            DocumentStatus status, int rating);
+
+    void RemoveFromHeadTermCache(int document_id, const std::map<std::string_view, double>& word_freqs);
+
+    // Записывает статус и рейтинг документа; при включённом ускорителе — под его блокировкой вместе
+    // с обновлением лучших документов, чтобы одновременные поиски видели согласованное состояние
+    void StoreDocumentData(int document_id, DocumentData& document_data, DocumentStatus status, int rating);
+
+    // Учитывает однословный запрос в части частот текущего потока
+    void RecordHeadTermQuery(const std::string_view& word) const;
+
+    // Выдача однословного запроса со статусом ACTUAL из ускорителя или nullopt, если запрос не однословный,
+    // слова нет в ускорителе или сохранённых документов не хватает для уверенного ответа
+    std::optional<std::vector<Document>> FindTopDocumentsInHeadTermCache(const std::string_view& raw_query) const;
     
     struct QueryWord {
         std::string_view data;
         bool is_minus;
         bool is_stop;
+        bool is_prefix;
+        // Допустимое расстояние редактирования (0 — точное совпадение)
+        int max_distance;
     };
 
     QueryWord ParseQueryWord(const std::string_view& text) const;
+
+    bool IsDynamicStopWord(const std::string_view& word) const;
     
+    // Слова запроса размещаются в ресурсе памяти запроса (обычно в QueryArena)
     struct Query {
-        std::set<std::string_view> plus_words;
-        std::set<std::string_view> minus_words;
+        explicit Query(std::pmr::memory_resource* resource)
+            : plus_words(resource)
+            , minus_words(resource)
+            , plus_word_weights(resource) {
+        }
+
+        double GetPlusWordWeight(const std::string_view& word) const {
+            const auto it = plus_word_weights.find(word);
+            return it == plus_word_weights.end() ? 1.0 : it->second;
+        }
+
+        // Слово, попавшее в запрос несколько раз, получает наибольший из весов
+        void AddPlusWord(const std::string_view& word, double weight) {
+            const bool is_new = plus_words.insert(word).second;
+            if (weight >= 1.0) {
+                plus_word_weights.erase(word);
+            } else if (is_new) {
+                plus_word_weights.emplace(word, weight);
+            } else if (const auto it = plus_word_weights.find(word); it != plus_word_weights.end()) {
+                it->second = std::max(it->second, weight);
+            }
+        }
+
+        std::pmr::set<std::string_view> plus_words;
+        std::pmr::set<std::string_view> minus_words;
+        // Веса плюс-слов, отличные от 1 (слова, найденные с опечаткой)
+        std::pmr::map<std::string_view, double> plus_word_weights;
+    };
+
+    Query ParseQuery(const std::string_view& text, std::pmr::memory_resource* resource) const;
+
+    // Запрос из слов expansion с теми же ограничениями раскрытия, что у ParseQuery; statistics получает
+    // число документов и документные частоты плюс-слов всех шардов. Строки запроса принадлежат expansion
+    static Query ParseExpandedQuery(const QueryExpansion& expansion, CorpusStatistics& statistics,
+                                    std::pmr::memory_resource* resource);
+
+    // Записывает в out слова словаря, начинающиеся с prefix, не более max_count
+    template <typename OutputIterator>
+    void ExpandPrefix(const std::string_view& prefix, int max_count, OutputIterator out) const;
+
+    // Передаёт callback(term, distance) слова словаря на расстоянии не больше max_distance от word.
+    // Если таких слов больше max_count, остаются ближайшие
+    template <typename Callback>
+    void ExpandFuzzyWord(const std::string_view& word, int max_distance, int max_count,
+                         std::pmr::memory_resource* resource, Callback callback) const;
+
+    struct ExecutionPlan {
+        bool is_parallel;
+        size_t thread_count;
     };
 
-    Query ParseQuery(const std::string_view& text) const;
+    // Суммарная длина списков документов плюс- и минус-слов запроса
+    size_t ComputeQueryPostingCount(const Query& query) const;
+
+    ExecutionPlan PlanExecution(const Query& query) const;
+
+    // Число потоков параллельного поиска по запросу с posting_count элементами списков документов
+    size_t ComputeThreadCount(const Query& query, size_t posting_count) const;
+
+    // Есть ли у процесса хотя бы два потока TBB
+    static bool HasParallelThreads();
+
+    // Размер арены TBB для thread_count потоков: не больше числа потоков, доступных процессу
+    static int GetArenaConcurrency(size_t thread_count);
 
     // Existence required
     double ComputeWordInverseDocumentFreq(const std::string_view& word) const;
 
+    // Existence required. Если statistics задана, IDF вычисляется по ней
+    double ComputeWordInverseDocumentFreq(const std::string_view& word, const CorpusStatistics* statistics) const;
+
+    // Проверка дедлайна одного запроса, общая для всех потоков параллельного поиска
+    class DeadlineMonitor {
+    public:
+        explicit DeadlineMonitor(const SearchDeadline& deadline)
+            : deadline_(deadline) {
+        }
+
+        // Вызывается на каждой записи списка документов; время проверяется раз в DEADLINE_CHECK_INTERVAL записей,
+        // а прерывание, замеченное одним потоком, видят остальные
+        bool IsExpired(size_t& posting_count) {
+            if (++posting_count < DEADLINE_CHECK_INTERVAL) {
+                return false;
+            }
+            posting_count = 0;
+            if (is_expired_.load(std::memory_order_relaxed)) {
+                return true;
+            }
+            if (deadline_.IsExpired()) {
+                is_expired_.store(true, std::memory_order_relaxed);
+                return true;
+            }
+            return false;
+        }
+
+        bool WasExpired() const {
+            return is_expired_.load(std::memory_order_relaxed);
+        }
+
+    private:
+        const SearchDeadline& deadline_;
+        std::atomic<bool> is_expired_ = false;
+    };
+
+    // Найденные документы размещаются в ресурсе памяти запроса. Если задан deadline_monitor,
+    // обход списков документов плюс-слов прекращается по дедлайну
+    // Запросы raw_queries[begin, end) пачки; их выдачи записываются в result[begin, end)
+    template <typename DocumentPredicate>
+    void FindTopDocumentsBatchPart(const std::vector<std::string_view>& raw_queries, size_t begin, size_t end,
+                                   DocumentPredicate document_predicate,
+                                   std::vector<std::vector<Document>>& result) const;
+
     template <typename DocumentPredicate>
-    std::vector<Document> FindAllDocuments(const Query& query, DocumentPredicate document_predicate) const; 
+    std::pmr::vector<Document> FindAllDocuments(const Query& query, DocumentPredicate document_predicate) const; 
     
     template <typename DocumentPredicate>
-    std::vector<Document> FindAllDocuments(const std::execution::sequenced_policy& seq_, const Query& query, 
-                                           DocumentPredicate document_predicate) const;
+    std::pmr::vector<Document> FindAllDocuments(const std::execution::sequenced_policy& seq_, const Query& query, 
+                                                DocumentPredicate document_predicate,
+                                                const CorpusStatistics* statistics = nullptr,
+                                                DeadlineMonitor* deadline_monitor = nullptr) const;
 
     template <typename DocumentPredicate>
-    std::vector<Document> FindAllDocuments(const std::execution::parallel_policy& par_, const Query& query, 
-                                           DocumentPredicate document_predicate) const;
+    std::pmr::vector<Document> FindAllDocuments(const std::execution::parallel_policy& par_, const Query& query, 
+                                                DocumentPredicate document_predicate,
+                                                const CorpusStatistics* statistics = nullptr,
+                                                DeadlineMonitor* deadline_monitor = nullptr,
+                                                size_t thread_count = PROCESSOR_CORES) const;
+
+    template <typename DocumentPredicate>
+    std::pmr::vector<Document> FindAllDocuments(const AutoExecutionPolicy& policy, const Query& query,
+                                                DocumentPredicate document_predicate,
+                                                const CorpusStatistics* statistics = nullptr,
+                                                DeadlineMonitor* deadline_monitor = nullptr) const;
+
+    struct PruningTerm {
+        const PostingList* postings;
+        // IDF с учётом веса слова; так как term_freq не больше 1, это и наибольший вклад слова
+        double weight;
+    };
+
+    // MAX_RESULT_DOCUMENT_COUNT документов с наибольшей накопленной релевантностью. Релевантность документа
+    // при поиске только растёт, поэтому набор остаётся точным, если сообщать каждое её новое значение
+    class TopRelevanceTracker {
+    public:
+        // Вызывается на каждый элемент списка документов, поэтому определена в классе. Значение не больше
+        // наименьшего в полном наборе отбрасывается одним сравнением: релевантность документа набора
+        // только росла с момента попадания в него, поэтому такое значение пришло от документа вне набора
+        void Update(int document_id, double relevance) {
+            if (size_ == top_documents_.size() && relevance <= top_documents_[min_index_].second) {
+                return;
+            }
+            for (size_t i = 0; i < size_; ++i) {
+                if (top_documents_[i].first == document_id) {
+                    top_documents_[i].second = relevance;
+                    if (i == min_index_) {
+                        UpdateMinIndex();
+                    }
+                    return;
+                }
+            }
+            if (size_ < top_documents_.size()) {
+                top_documents_[size_++] = {document_id, relevance};
+            } else {
+                top_documents_[min_index_] = {document_id, relevance};
+            }
+            UpdateMinIndex();
+        }
+
+        // MAX_RESULT_DOCUMENT_COUNT-я по величине релевантность или -inf, если документов меньше
+        double GetThreshold() const {
+            return size_ < top_documents_.size() ? -std::numeric_limits<double>::infinity()
+                                                 : top_documents_[min_index_].second;
+        }
+
+    private:
+        std::array<std::pair<int, double>, MAX_RESULT_DOCUMENT_COUNT> top_documents_;
+        size_t size_ = 0;
+        // Документ набора с наименьшей релевантностью
+        size_t min_index_ = 0;
+
+        void UpdateMinIndex();
+    };
+
+    // Поиск с отсечением по query_pruning_ (алгоритм MaxScore). Слова обходятся по убыванию IDF; как только
+    // вклад оставшихся слов не может поднять новый документ выше порога лучших, они становятся несущественными,
+    // и их частоты ищутся в списках документов только для кандидатов, ещё способных попасть в выдачу.
+    // Возвращает кандидатов, среди которых есть лучшие документы запроса, но не все найденные документы
+    template <typename ExecutionPolicy, typename DocumentPredicate>
+    std::pmr::vector<Document> FindTopCandidates(const ExecutionPolicy& policy, const Query& query,
+                                                 DocumentPredicate document_predicate,
+                                                 size_t thread_count = PROCESSOR_CORES) const;
+
+    template <typename DocumentPredicate>
+    std::pmr::vector<Document> FindTopCandidates(const AutoExecutionPolicy& policy, const Query& query,
+                                                 DocumentPredicate document_predicate) const;
 };
 
 void AddDocument(SearchServer& search_server, int document_id, const std::string_view& document, DocumentStatus status,
@@ -143,10 +819,12 @@ void MatchDocuments(const SearchServer& search_server, const std::string_view& q
 
 template <typename StringContainer>
 SearchServer::SearchServer(const StringContainer& stop_words)
-    : stop_words_(MakeUniqueNonEmptyStrings<StringContainer>(stop_words)) { // Extract non-empty stop wordsstd
-    if (!all_of(stop_words_.begin(), stop_words_.end(), IsValidWord)) {
-        throw std::invalid_argument("Some of stop words are invalid");
-    }
+    : SearchServer(PerfectHashSet(MakeUniqueNonEmptyStrings<StringContainer>(stop_words))) { // Extract non-empty stop words
+}
+
+template <size_t N>
+SearchServer::SearchServer(const PerfectHashTable<N>& stop_words)
+    : SearchServer(PerfectHashSet(stop_words)) {
 }
 
 template <typename DocumentPredicate>
@@ -157,60 +835,406 @@ std::vector<Document> SearchServer::FindTopDocuments(const std::string_view& raw
 template <typename DocumentPredicate>
 std::vector<Document> SearchServer::FindTopDocuments(const std::execution::sequenced_policy& seq_, const std::string_view& raw_query,
                                                      DocumentPredicate document_predicate) const {
-    const auto query = ParseQuery(raw_query);
-    auto matched_documents = FindAllDocuments(seq_, query, document_predicate);
-    std::sort(matched_documents.begin(), matched_documents.end(), [](const Document& lhs, const Document& rhs) {
-        if (std::abs(lhs.relevance - rhs.relevance) < EPSILON) {
-            return lhs.rating > rhs.rating;
-        } else {
-            return lhs.relevance > rhs.relevance;
-        }
-    });
-    if (matched_documents.size() > MAX_RESULT_DOCUMENT_COUNT) {
-        matched_documents.resize(MAX_RESULT_DOCUMENT_COUNT);
-    }
+    QueryArena arena;
+    const auto query = ParseQuery(raw_query, arena.GetResource());
+    auto matched_documents = query_pruning_.enabled ? FindTopCandidates(seq_, query, document_predicate)
+                                                    : FindAllDocuments(seq_, query, document_predicate);
+    SelectTopDocuments(matched_documents);
 
-    return matched_documents;
+    return {matched_documents.begin(), matched_documents.end()};
 }
 
 template <typename DocumentPredicate>
 std::vector<Document> SearchServer::FindTopDocuments(const std::execution::parallel_policy& par_, const std::string_view& raw_query,
                                        DocumentPredicate document_predicate) const {
-    const auto query = ParseQuery(raw_query);
-    auto matched_documents = FindAllDocuments(par_, query, document_predicate);
+    QueryArena arena;
+    const auto query = ParseQuery(raw_query, arena.GetResource());
+    auto matched_documents = query_pruning_.enabled ? FindTopCandidates(par_, query, document_predicate)
+                                                    : FindAllDocuments(par_, query, document_predicate);
+    SelectTopDocuments(matched_documents);
+
+    return {matched_documents.begin(), matched_documents.end()};
+}
+
+template <typename DocumentPredicate>
+std::vector<Document> SearchServer::FindTopDocuments(const AutoExecutionPolicy& policy, const std::string_view& raw_query,
+                                                     DocumentPredicate document_predicate) const {
+    QueryArena arena;
+    const auto query = ParseQuery(raw_query, arena.GetResource());
+    auto matched_documents = query_pruning_.enabled ? FindTopCandidates(policy, query, document_predicate)
+                                                    : FindAllDocuments(policy, query, document_predicate);
+    SelectTopDocuments(matched_documents);
+
+    return {matched_documents.begin(), matched_documents.end()};
+}
 
-    std::sort(matched_documents.begin(), matched_documents.end(), [](const Document& lhs, const Document& rhs) {
-        if (std::abs(lhs.relevance - rhs.relevance) < EPSILON) {
-            return lhs.rating > rhs.rating;
-        } else {
-            return lhs.relevance > rhs.relevance;
+template <typename DocumentPredicate>
+std::vector<std::vector<Document>> SearchServer::FindTopDocumentsBatch(const std::vector<std::string_view>& raw_queries,
+                                                                       DocumentPredicate document_predicate) const {
+    std::vector<std::vector<Document>> result(raw_queries.size());
+    // Отсечение у каждого запроса своё, поэтому с ним запросы ищутся по отдельности, как в FindTopDocuments
+    if (query_pruning_.enabled) {
+        for (size_t query_index = 0; query_index < raw_queries.size(); ++query_index) {
+            QueryArena arena;
+            const auto query = ParseQuery(raw_queries[query_index], arena.GetResource());
+            auto matched_documents = FindTopCandidates(std::execution::seq, query, document_predicate);
+            SelectTopDocuments(matched_documents);
+            result[query_index].assign(matched_documents.begin(), matched_documents.end());
         }
-    });
-    
-    if (matched_documents.size() > MAX_RESULT_DOCUMENT_COUNT) {
-        matched_documents.resize(MAX_RESULT_DOCUMENT_COUNT);
+        return result;
     }
+    for (size_t begin = 0; begin < raw_queries.size(); begin += BATCH_PART_QUERY_COUNT) {
+        const size_t end = std::min(begin + BATCH_PART_QUERY_COUNT, raw_queries.size());
+        FindTopDocumentsBatchPart(raw_queries, begin, end, document_predicate, result);
+    }
+    return result;
+}
 
-    return matched_documents;
+template <typename DocumentPredicate>
+void SearchServer::FindTopDocumentsBatchPart(const std::vector<std::string_view>& raw_queries, size_t begin, size_t end,
+                                             DocumentPredicate document_predicate,
+                                             std::vector<std::vector<Document>>& result) const {
+    QueryArena arena;
+    std::pmr::memory_resource* resource = arena.GetResource();
+
+    std::pmr::vector<Query> queries(resource);
+    queries.reserve(end - begin);
+    for (size_t query_index = begin; query_index < end; ++query_index) {
+        queries.push_back(ParseQuery(raw_queries[query_index], resource));
+    }
+
+    // Для каждого слова хранятся его список документов, номера запросов и вес слова в них. Конструктор
+    // с аллокатором нужен, чтобы pmr::map выделял query_weights на арене
+    struct WordQueries {
+        using allocator_type = std::pmr::polymorphic_allocator<char>;
+
+        explicit WordQueries(const allocator_type& allocator)
+            : query_weights(allocator) {
+        }
+
+        const PostingList* postings = nullptr;
+        std::pmr::vector<std::pair<size_t, double>> query_weights;
+    };
+    std::pmr::map<std::string_view, WordQueries> word_to_queries(resource);
+    std::pmr::vector<size_t> posting_counts(queries.size(), 0, resource);
+    for (size_t query_index = 0; query_index < queries.size(); ++query_index) {
+        for (const std::string_view& word : queries[query_index].plus_words) {
+            auto [word_queries_iter, is_inserted] = word_to_queries.try_emplace(word);
+            WordQueries& word_queries = word_queries_iter->second;
+            if (is_inserted) {
+                const auto word_iter = word_to_document_freqs_.find(word);
+                word_queries.postings = word_iter == word_to_document_freqs_.end() ? nullptr : &word_iter->second;
+            }
+            word_queries.query_weights.emplace_back(query_index, queries[query_index].GetPlusWordWeight(word));
+            posting_counts[query_index] += word_queries.postings == nullptr ? 0 : word_queries.postings->size();
+        }
+    }
+
+    // Вклады слов в релевантность документов копятся подряд в векторе запроса, размер которого известен заранее.
+    // Вклады одного слова идут по возрастанию id и образуют отрезок, границы отрезков хранятся в run_ends
+    struct Contribution {
+        int document_id;
+        double relevance;
+    };
+    std::pmr::vector<std::pmr::vector<Contribution>> contributions(queries.size(), resource);
+    std::pmr::vector<std::pmr::vector<size_t>> run_ends(queries.size(), resource);
+    for (size_t query_index = 0; query_index < queries.size(); ++query_index) {
+        contributions[query_index].reserve(posting_counts[query_index]);
+        run_ends[query_index].reserve(queries[query_index].plus_words.size());
+    }
+    for (const auto& [word, word_queries] : word_to_queries) {
+        if (word_queries.postings == nullptr) {
+            continue;
+        }
+        const double inverse_document_freq = ComputeWordInverseDocumentFreq(word);
+        for (const auto [document_id, term_freq] : *word_queries.postings) {
+            const auto& document_data = documents_.at(document_id);
+            if (!document_predicate(document_id, document_data.status, document_data.rating)) {
+                continue;
+            }
+            for (const auto& [query_index, weight] : word_queries.query_weights) {
+                contributions[query_index].push_back({document_id, term_freq * (inverse_document_freq * weight)});
+            }
+        }
+        for (const auto& [query_index, _] : word_queries.query_weights) {
+            run_ends[query_index].push_back(contributions[query_index].size());
+        }
+    }
+
+    std::pmr::vector<size_t> run_positions(resource);
+    for (size_t query_index = 0; query_index < queries.size(); ++query_index) {
+        const auto& query_contributions = contributions[query_index];
+        const auto& query_run_ends = run_ends[query_index];
+        // Отрезки сливаются в документы по возрастанию id. Отрезки слов лежат в порядке plus_words отдельного
+        // запроса, поэтому вклады документа складываются в том же порядке, что в FindTopDocuments, и
+        // релевантность совпадает с ней до бита
+        run_positions.resize(query_run_ends.size());
+        for (size_t run = 0; run < query_run_ends.size(); ++run) {
+            run_positions[run] = run == 0 ? 0 : query_run_ends[run - 1];
+        }
+        std::pmr::vector<Document> matched_documents(resource);
+        matched_documents.reserve(query_contributions.size());
+        while (true) {
+            int document_id = std::numeric_limits<int>::max();
+            bool has_contribution = false;
+            for (size_t run = 0; run < query_run_ends.size(); ++run) {
+                if (run_positions[run] < query_run_ends[run]) {
+                    document_id = std::min(document_id, query_contributions[run_positions[run]].document_id);
+                    has_contribution = true;
+                }
+            }
+            if (!has_contribution) {
+                break;
+            }
+            double relevance = 0.0;
+            for (size_t run = 0; run < query_run_ends.size(); ++run) {
+                if (run_positions[run] < query_run_ends[run]
+                    && query_contributions[run_positions[run]].document_id == document_id) {
+                    relevance += query_contributions[run_positions[run]++].relevance;
+                }
+            }
+            matched_documents.push_back({document_id, relevance, documents_.at(document_id).rating});
+        }
+
+        const auto is_id_less = [](const Document& document, int document_id) {
+            return document.id < document_id;
+        };
+        for (const std::string_view& word : queries[query_index].minus_words) {
+            const auto word_iter = word_to_document_freqs_.find(word);
+            if (word_iter == word_to_document_freqs_.end()) {
+                continue;
+            }
+            for (const auto [document_id, _] : word_iter->second) {
+                const auto document_iter = std::lower_bound(matched_documents.begin(), matched_documents.end(),
+                                                            document_id, is_id_less);
+                if (document_iter != matched_documents.end() && document_iter->id == document_id) {
+                    document_iter->relevance = -std::numeric_limits<double>::infinity();
+                }
+            }
+        }
+        matched_documents.erase(std::remove_if(matched_documents.begin(), matched_documents.end(),
+                                               [](const Document& document) {
+                                                   return document.relevance == -std::numeric_limits<double>::infinity();
+                                               }),
+                                matched_documents.end());
+        SelectTopDocuments(matched_documents);
+        result[begin + query_index].assign(matched_documents.begin(), matched_documents.end());
+    }
+}
+
+template <typename ExecutionPolicy, typename DocumentPredicate>
+std::vector<Document> SearchServer::FindTopDocuments(const ExecutionPolicy& policy, const std::string_view& raw_query,
+                                                     DocumentPredicate document_predicate, const CorpusStatistics& statistics) const {
+    QueryArena arena;
+    const auto query = ParseQuery(raw_query, arena.GetResource());
+    auto matched_documents = FindAllDocuments(policy, query, document_predicate, &statistics);
+    SelectTopDocuments(matched_documents);
+
+    return {matched_documents.begin(), matched_documents.end()};
+}
+
+template <typename ExecutionPolicy, typename DocumentPredicate>
+std::vector<Document> SearchServer::FindTopDocuments(const ExecutionPolicy& policy, const std::string_view& raw_query,
+                                                     DocumentPredicate document_predicate,
+                                                     const std::vector<int>& original_ids) const {
+    QueryArena arena;
+    const auto query = ParseQuery(raw_query, arena.GetResource());
+    auto matched_documents = FindAllDocuments(policy, query, document_predicate);
+    for (Document& document : matched_documents) {
+        document.id = original_ids.at(document.id);
+    }
+    SelectTopDocuments(matched_documents);
+
+    return {matched_documents.begin(), matched_documents.end()};
+}
+
+template <typename ExecutionPolicy, typename DocumentPredicate>
+std::vector<Document> SearchServer::FindTopDocuments(const ExecutionPolicy& policy, const QueryExpansion& expansion,
+                                                     DocumentPredicate document_predicate) const {
+    QueryArena arena;
+    CorpusStatistics statistics;
+    const auto query = ParseExpandedQuery(expansion, statistics, arena.GetResource());
+    auto matched_documents = FindAllDocuments(policy, query, document_predicate, &statistics);
+    SelectTopDocuments(matched_documents);
+
+    return {matched_documents.begin(), matched_documents.end()};
+}
+
+template <typename ExecutionPolicy, typename DocumentPredicate>
+SearchResult SearchServer::FindTopDocuments(const ExecutionPolicy& policy, const std::string_view& raw_query,
+                                            DocumentPredicate document_predicate, const SearchDeadline& deadline) const {
+    QueryArena arena;
+    const auto query = ParseQuery(raw_query, arena.GetResource());
+    DeadlineMonitor deadline_monitor(deadline);
+    auto matched_documents = FindAllDocuments(policy, query, document_predicate, nullptr, &deadline_monitor);
+    SelectTopDocuments(matched_documents);
+
+    const bool is_partial = deadline_monitor.WasExpired();
+    if (is_partial) {
+        query_counters_->truncated.fetch_add(1, std::memory_order_relaxed);
+    }
+    return {{matched_documents.begin(), matched_documents.end()}, is_partial};
+}
+
+template <typename ExecutionPolicy>
+SearchResult SearchServer::FindTopDocuments(const ExecutionPolicy& policy, const std::string_view& raw_query,
+                                            DocumentStatus status, const SearchDeadline& deadline) const {
+    return FindTopDocuments(policy, raw_query, [status](int document_id, DocumentStatus document_status, int rating) {
+                                return document_status == status;
+                            }, deadline);
 }
 
 template <typename DocumentPredicate>
-std::vector<Document> SearchServer::FindAllDocuments(const Query& query, 
+SearchPage SearchServer::FindTopDocumentsAfter(const SearchCursor& cursor, DocumentPredicate document_predicate) const {
+    QueryArena arena;
+    std::pmr::memory_resource* resource = arena.GetResource();
+
+    struct TermPostings {
+        PostingList::const_iterator it;
+        PostingList::const_iterator end;
+        double weight;
+    };
+    const auto collect_postings = [this, resource](const auto& words, const auto& get_word, const auto& get_weight) {
+        std::pmr::vector<TermPostings> postings(resource);
+        postings.reserve(words.size());
+        for (const auto& word : words) {
+            const auto word_iter = word_to_document_freqs_.find(get_word(word));
+            if (word_iter != word_to_document_freqs_.end()) {
+                postings.push_back({word_iter->second.begin(), word_iter->second.end(), get_weight(word)});
+            }
+        }
+        return postings;
+    };
+    auto plus_postings = collect_postings(cursor.terms_->plus_terms,
+                                          [](const SearchCursor::Term& term) -> const std::string& { return term.word; },
+                                          [](const SearchCursor::Term& term) { return term.weight; });
+    auto minus_postings = collect_postings(cursor.terms_->minus_words,
+                                           [](const std::string& word) -> const std::string& { return word; },
+                                           [](const std::string&) { return 0.0; });
+
+    // Куча лучших документов после курсора: в начале худший из них
+    std::pmr::vector<Document> top_documents(resource);
+    top_documents.reserve(MAX_RESULT_DOCUMENT_COUNT);
+    while (true) {
+        int document_id = std::numeric_limits<int>::max();
+        bool has_postings = false;
+        for (const TermPostings& postings : plus_postings) {
+            if (postings.it != postings.end) {
+                document_id = std::min(document_id, postings.it->first);
+                has_postings = true;
+            }
+        }
+        if (!has_postings) {
+            break;
+        }
+        double relevance = 0.0;
+        for (TermPostings& postings : plus_postings) {
+            if (postings.it != postings.end && postings.it->first == document_id) {
+                relevance += postings.it->second * postings.weight;
+                ++postings.it;
+            }
+        }
+        const bool is_excluded = std::any_of(minus_postings.begin(), minus_postings.end(),
+                                             [document_id](TermPostings& postings) {
+                                                 while (postings.it != postings.end && postings.it->first < document_id) {
+                                                     ++postings.it;
+                                                 }
+                                                 return postings.it != postings.end && postings.it->first == document_id;
+                                             });
+        if (is_excluded) {
+            continue;
+        }
+        const auto& document_data = documents_.at(document_id);
+        const int rating = document_data.rating;
+        if (!document_predicate(document_id, document_data.status, rating)) {
+            continue;
+        }
+        const Document document{document_id, relevance, rating};
+        if (cursor.last_document_ && !IsPagedBefore(*cursor.last_document_, document)) {
+            continue;
+        }
+        if (top_documents.size() < MAX_RESULT_DOCUMENT_COUNT) {
+            top_documents.push_back(document);
+            std::push_heap(top_documents.begin(), top_documents.end(), IsPagedBefore);
+        } else if (IsPagedBefore(document, top_documents.front())) {
+            std::pop_heap(top_documents.begin(), top_documents.end(), IsPagedBefore);
+            top_documents.back() = document;
+            std::push_heap(top_documents.begin(), top_documents.end(), IsPagedBefore);
+        }
+    }
+    std::sort_heap(top_documents.begin(), top_documents.end(), IsPagedBefore);
+
+    SearchPage page{{top_documents.begin(), top_documents.end()}, cursor};
+    if (!page.documents.empty()) {
+        page.next.last_document_ = page.documents.back();
+    }
+    return page;
+}
+
+template <typename Documents>
+void SearchServer::SelectTopDocuments(Documents& matched_documents) {
+    const size_t result_size = std::min<size_t>(matched_documents.size(), MAX_RESULT_DOCUMENT_COUNT);
+    std::partial_sort(matched_documents.begin(), matched_documents.begin() + result_size, matched_documents.end(),
+                      IsRankedBefore);
+    matched_documents.resize(result_size);
+}
+
+template <typename OutputIterator>
+void SearchServer::ExpandPrefix(const std::string_view& prefix, int max_count, OutputIterator out) const {
+    int expansion_count = 0;
+    for (auto it = word_to_document_freqs_.lower_bound(prefix);
+         it != word_to_document_freqs_.end() && expansion_count < max_count; ++it, ++expansion_count) {
+        if (it->first.substr(0, prefix.size()) != prefix) {
+            break;
+        }
+        *out++ = it->first;
+    }
+}
+
+template <typename Callback>
+void SearchServer::ExpandFuzzyWord(const std::string_view& word, int max_distance, int max_count,
+                                   std::pmr::memory_resource* resource, Callback callback) const {
+    std::pmr::vector<std::pair<int, std::string_view>> matches(resource);
+    LevenshteinAutomaton(word, max_distance, resource).ForEachMatch(word_to_document_freqs_,
+        [&matches](const std::string_view& term, int distance) {
+            matches.emplace_back(distance, term);
+        });
+    if (matches.size() > static_cast<size_t>(max_count)) {
+        std::nth_element(matches.begin(), matches.begin() + max_count, matches.end());
+        matches.resize(max_count);
+    }
+    for (const auto& [distance, term] : matches) {
+        callback(term, distance);
+    }
+}
+
+template <typename DocumentPredicate>
+std::pmr::vector<Document> SearchServer::FindAllDocuments(const Query& query, 
                                                      DocumentPredicate document_predicate) const {
     return FindAllDocuments<DocumentPredicate>(std::execution::seq, query, document_predicate);
 }
        
 template <typename DocumentPredicate>
-std::vector<Document> SearchServer::FindAllDocuments(const std::execution::sequenced_policy& seq_, const Query& query, 
-                                                     DocumentPredicate document_predicate) const {
+std::pmr::vector<Document> SearchServer::FindAllDocuments(const std::execution::sequenced_policy& seq_, const Query& query, 
+                                                          DocumentPredicate document_predicate,
+                                                          const CorpusStatistics* statistics,
+                                                          DeadlineMonitor* deadline_monitor) const {
+    std::pmr::memory_resource* resource = query.plus_words.get_allocator().resource();
 
-    std::map<int, double> document_to_relevance;
+    std::pmr::map<int, double> document_to_relevance(resource);
+    size_t posting_count = 0;
     for (const std::string_view& word : query.plus_words) {
         if (word_to_document_freqs_.count(word) == 0) {
             continue;
         }
-        const double inverse_document_freq = ComputeWordInverseDocumentFreq(word);
+        if (deadline_monitor != nullptr && deadline_monitor->WasExpired()) {
+            break;
+        }
+        const double inverse_document_freq = ComputeWordInverseDocumentFreq(word, statistics) * query.GetPlusWordWeight(word);
         for (const auto [document_id, term_freq] : word_to_document_freqs_.at(word)) {
+            if (deadline_monitor != nullptr && deadline_monitor->IsExpired(posting_count)) {
+                break;
+            }
             const auto& document_data = documents_.at(document_id);
             if (document_predicate(document_id, document_data.status, document_data.rating)) {
                 document_to_relevance[document_id] += term_freq * inverse_document_freq;
@@ -227,7 +1251,8 @@ std::vector<Document> SearchServer::FindAllDocuments(const std::execution::seque
         }
     }
 
-    std::vector<Document> matched_documents;
+    std::pmr::vector<Document> matched_documents(resource);
+    matched_documents.reserve(document_to_relevance.size());
     for (const auto [document_id, relevance] : document_to_relevance) {
         matched_documents.push_back({ document_id, relevance, documents_.at(document_id).rating });
     }
@@ -235,32 +1260,59 @@ std::vector<Document> SearchServer::FindAllDocuments(const std::execution::seque
 }
 
 template <typename DocumentPredicate>
-std::vector<Document> SearchServer::FindAllDocuments(const std::execution::parallel_policy& par_, const Query& query,
-                                                     DocumentPredicate document_predicate) const {
+std::pmr::vector<Document> SearchServer::FindAllDocuments(const AutoExecutionPolicy& policy, const Query& query,
+                                                          DocumentPredicate document_predicate,
+                                                          const CorpusStatistics* statistics,
+                                                          DeadlineMonitor* deadline_monitor) const {
+    const ExecutionPlan plan = PlanExecution(query);
+    if (plan.is_parallel) {
+        return FindAllDocuments(std::execution::par, query, document_predicate, statistics, deadline_monitor, plan.thread_count);
+    }
+    return FindAllDocuments(std::execution::seq, query, document_predicate, statistics, deadline_monitor);
+}
+
+template <typename DocumentPredicate>
+std::pmr::vector<Document> SearchServer::FindAllDocuments(const std::execution::parallel_policy& par_, const Query& query,
+                                                          DocumentPredicate document_predicate,
+                                                          const CorpusStatistics* statistics,
+                                                          DeadlineMonitor* deadline_monitor,
+                                                          size_t thread_count) const {
+    std::pmr::memory_resource* resource = query.plus_words.get_allocator().resource();
+
 //Копируем set плюс-слов и set минус-слов в вектора для получения итераторов произвольного доступа
-    std::vector<std::string_view> vector_plus_words;
-    vector_plus_words.reserve(query.plus_words.size());
-    std::vector<std::string_view> vector_minus_words;
-    vector_minus_words.reserve(query.minus_words.size());
-    std::copy(par_, query.plus_words.begin(), query.plus_words.end(), std::back_inserter(vector_plus_words));
-    std::copy(par_, query.minus_words.begin(), query.minus_words.end(), std::back_inserter(vector_minus_words));
-
-//Разбиваем document_to_relevance на 8 подсловарей для безопасного параллельного доступа, из расчета по 2 подсловаря на 1 ядро процессора    
-    ConcurrentMap<int, double> document_to_relevance(PROCESSOR_CORES*2);
-    std::for_each(par_, vector_plus_words.begin(), vector_plus_words.end(), 
-                  [&document_to_relevance, &document_predicate, this](const auto& word) {
-                    if (word_to_document_freqs_.count(word) == 0) {
-                        return;
-                    }
-                    const double inverse_document_freq = ComputeWordInverseDocumentFreq(word);
-                    for (const auto [document_id, term_freq] : word_to_document_freqs_.at(word)) {
-                        const auto& document_data = documents_.at(document_id);
-                        if (document_predicate(document_id, document_data.status, document_data.rating)) {
-                            document_to_relevance[document_id].ref_to_value += term_freq * inverse_document_freq;
+    std::pmr::vector<std::string_view> vector_plus_words(query.plus_words.begin(), query.plus_words.end(), resource);
+    std::pmr::vector<std::string_view> vector_minus_words(query.minus_words.begin(), query.minus_words.end(), resource);
+
+//Разбиваем document_to_relevance на подсловари для безопасного параллельного доступа, из расчета по 2 подсловаря на 1 поток.
+//Подсловари растут из ресурса запроса через синхронизирующую обёртку
+    SynchronizedResource synchronized_resource(resource);
+    ConcurrentMap<int, double> document_to_relevance(thread_count*2, &synchronized_resource);
+//Параллельный алгоритм занимает потоки только той арены TBB, в которой запущен
+    tbb::task_arena task_arena(GetArenaConcurrency(thread_count));
+    task_arena.execute([&] {
+        std::for_each(par_, vector_plus_words.begin(), vector_plus_words.end(), 
+                      [&document_to_relevance, &document_predicate, &query, statistics, deadline_monitor, this](const auto& word) {
+                        if (word_to_document_freqs_.count(word) == 0) {
+                            return;
                         }
-                    }
-                });
-    std::map<int, double> document_to_relevance_map = std::move(document_to_relevance.BuildOrdinaryMap());
+                        if (deadline_monitor != nullptr && deadline_monitor->WasExpired()) {
+                            return;
+                        }
+                        const double inverse_document_freq = ComputeWordInverseDocumentFreq(word, statistics)
+                                                             * query.GetPlusWordWeight(word);
+                        size_t posting_count = 0;
+                        for (const auto [document_id, term_freq] : word_to_document_freqs_.at(word)) {
+                            if (deadline_monitor != nullptr && deadline_monitor->IsExpired(posting_count)) {
+                                return;
+                            }
+                            const auto& document_data = documents_.at(document_id);
+                            if (document_predicate(document_id, document_data.status, document_data.rating)) {
+                                document_to_relevance[document_id].ref_to_value += term_freq * inverse_document_freq;
+                            }
+                        }
+                    });
+    });
+    std::pmr::map<int, double> document_to_relevance_map = document_to_relevance.BuildOrdinaryMap(resource);
     std::for_each(vector_minus_words.begin(), vector_minus_words.end(),
                   [&document_to_relevance_map, this](const auto& word) {
                     if (word_to_document_freqs_.count(word) == 0) {
@@ -271,10 +1323,141 @@ std::vector<Document> SearchServer::FindAllDocuments(const std::execution::paral
                     }
                 }); 
         
-    std::vector<Document> matched_documents;
+    std::pmr::vector<Document> matched_documents(resource);
+    matched_documents.reserve(document_to_relevance_map.size());
     for (const auto [document_id, relevance] : document_to_relevance_map) {
         matched_documents.push_back({ document_id, relevance, documents_.at(document_id).rating });
     }
     
     return matched_documents;
-}
\ No newline at end of file
+}
+template <typename DocumentPredicate>
+std::pmr::vector<Document> SearchServer::FindTopCandidates(const AutoExecutionPolicy& policy, const Query& query,
+                                                           DocumentPredicate document_predicate) const {
+    const ExecutionPlan plan = PlanExecution(query);
+    if (plan.is_parallel) {
+        return FindTopCandidates(std::execution::par, query, document_predicate, plan.thread_count);
+    }
+    return FindTopCandidates(std::execution::seq, query, document_predicate);
+}
+
+template <typename ExecutionPolicy, typename DocumentPredicate>
+std::pmr::vector<Document> SearchServer::FindTopCandidates(const ExecutionPolicy& policy, const Query& query,
+                                                           DocumentPredicate document_predicate,
+                                                           size_t thread_count) const {
+    constexpr bool is_parallel = std::is_same_v<ExecutionPolicy, std::execution::parallel_policy>;
+    std::pmr::memory_resource* resource = query.plus_words.get_allocator().resource();
+
+    // Документы с минус-словами исключаются до подсчёта, чтобы порог лучших строился только по допустимым документам
+    std::pmr::set<int> excluded_documents(resource);
+    for (const std::string_view& word : query.minus_words) {
+        const auto word_iter = word_to_document_freqs_.find(word);
+        if (word_iter == word_to_document_freqs_.end()) {
+            continue;
+        }
+        for (const auto [document_id, _] : word_iter->second) {
+            excluded_documents.insert(document_id);
+        }
+    }
+
+    std::pmr::vector<PruningTerm> terms(resource);
+    terms.reserve(query.plus_words.size());
+    for (const std::string_view& word : query.plus_words) {
+        const auto word_iter = word_to_document_freqs_.find(word);
+        if (word_iter != word_to_document_freqs_.end()) {
+            terms.push_back({&word_iter->second, ComputeWordInverseDocumentFreq(word) * query.GetPlusWordWeight(word)});
+        }
+    }
+    std::sort(terms.begin(), terms.end(), [](const PruningTerm& lhs, const PruningTerm& rhs) {
+        return lhs.weight > rhs.weight;
+    });
+
+    // remaining_bounds[i] — наибольший суммарный вклад слов terms[i], terms[i + 1], ...
+    std::pmr::vector<double> remaining_bounds(terms.size() + 1, 0.0, resource);
+    for (size_t i = terms.size(); i > 0; --i) {
+        remaining_bounds[i - 1] = remaining_bounds[i] + terms[i - 1].weight;
+    }
+    const auto is_below_threshold = [this, &remaining_bounds](double relevance, size_t term_index, double threshold) {
+        return relevance + remaining_bounds[term_index] * query_pruning_.accuracy < threshold - EPSILON;
+    };
+
+    std::pmr::map<int, double> document_to_relevance(resource);
+    TopRelevanceTracker top_relevance;
+    const auto add_relevance = [&document_to_relevance, &top_relevance](int document_id, double relevance) {
+        double& total_relevance = document_to_relevance[document_id];
+        total_relevance += relevance;
+        top_relevance.Update(document_id, total_relevance);
+    };
+    const auto add_term = [this, &excluded_documents, &document_predicate](const PruningTerm& term, auto add_relevance) {
+        for (const auto [document_id, term_freq] : *term.postings) {
+            const auto& document_data = documents_.at(document_id);
+            if (excluded_documents.count(document_id) == 0
+                && document_predicate(document_id, document_data.status, document_data.rating)) {
+                add_relevance(document_id, term_freq * term.weight);
+            }
+        }
+    };
+
+    size_t essential_count = 0;
+    double threshold = -std::numeric_limits<double>::infinity();
+    for (; essential_count < terms.size(); ++essential_count) {
+        // Порог не больше суммы вкладов уже обойдённых слов, поэтому до этого момента его не пересчитываем
+        if (remaining_bounds[0] - remaining_bounds[essential_count] > remaining_bounds[essential_count] * query_pruning_.accuracy) {
+            threshold = top_relevance.GetThreshold();
+            if (is_below_threshold(0.0, essential_count, threshold)) {
+                break;
+            }
+        }
+        // Параллельный вариант обходит последовательно только короткие списки, а длинные распределяет по потокам
+        if (is_parallel && terms[essential_count].postings->size() >= execution_calibration_.postings_per_thread) {
+            break;
+        }
+        add_term(terms[essential_count], add_relevance);
+    }
+
+    if constexpr (is_parallel) {
+        threshold = top_relevance.GetThreshold();
+        size_t essential_end = essential_count;
+        while (essential_end < terms.size() && !is_below_threshold(0.0, essential_end, threshold)) {
+            ++essential_end;
+        }
+        if (essential_end > essential_count) {
+            SynchronizedResource synchronized_resource(resource);
+            ConcurrentMap<int, double> concurrent_relevance(thread_count * 2, &synchronized_resource);
+            tbb::task_arena task_arena(GetArenaConcurrency(thread_count));
+            task_arena.execute([&] {
+                std::for_each(policy, terms.begin() + essential_count, terms.begin() + essential_end,
+                              [&add_term, &concurrent_relevance](const PruningTerm& term) {
+                                  add_term(term, [&concurrent_relevance](int document_id, double relevance) {
+                                      concurrent_relevance[document_id].ref_to_value += relevance;
+                                  });
+                              });
+            });
+            for (const auto [document_id, relevance] : concurrent_relevance.BuildOrdinaryMap(resource)) {
+                add_relevance(document_id, relevance);
+            }
+            essential_count = essential_end;
+            threshold = top_relevance.GetThreshold();
+        }
+    }
+
+    std::pmr::vector<Document> matched_documents(resource);
+    matched_documents.reserve(document_to_relevance.size());
+    for (const auto [document_id, relevance] : document_to_relevance) {
+        if (essential_count == terms.size() || !is_below_threshold(relevance, essential_count, threshold)) {
+            matched_documents.push_back({ document_id, relevance, documents_.at(document_id).rating });
+        }
+    }
+
+    // Вклад несущественных слов добавляется кандидатам поиском в списках документов
+    std::for_each(policy, matched_documents.begin(), matched_documents.end(),
+                  [&terms, essential_count](Document& document) {
+                      for (size_t i = essential_count; i < terms.size(); ++i) {
+                          const auto posting_iter = terms[i].postings->find(document.id);
+                          if (posting_iter != terms[i].postings->end()) {
+                              document.relevance += posting_iter->second * terms[i].weight;
+                          }
+                      }
+                  });
+    return matched_documents;
+}
@@ -0,0 +1,85 @@
+#include <atomic>
+#include <cstdlib>
+#include <execution>
+#include <iostream>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include "test_example_functions.h"
+
+using namespace std;
+
+namespace {
+
+std::atomic<bool> is_counting_allocations = false;
+std::atomic<size_t> allocation_count = 0;
+
+// Считает выделения памяти из кучи в повторном (с прогретой ареной потока) последовательном запросе raw_query.
+// Бросает std::logic_error, если их больше max_allocation_count
+void TestQueryAllocations(const SearchServer& search_server, const std::string_view& raw_query,
+                          size_t max_allocation_count) {
+    search_server.FindTopDocuments(std::execution::seq, raw_query);
+    allocation_count = 0;
+    is_counting_allocations = true;
+    search_server.FindTopDocuments(std::execution::seq, raw_query);
+    is_counting_allocations = false;
+    if (allocation_count > max_allocation_count) {
+        throw std::logic_error("Query \""s + std::string(raw_query) + "\" allocates "s + std::to_string(allocation_count)
+                               + " times, more than "s + std::to_string(max_allocation_count));
+    }
+}
+
+// Последовательный поиск с прогретой ареной выделяет из кучи только вектор результата. Параллельный
+// не проверяется: каждый запрос создаёт арену TBB, данные которой выделяются из кучи
+void TestSequentialQueryAllocations() {
+    SearchServer search_server("and with"s);
+    for (int id = 0; id < 1000; ++id) {
+        const string text = "cat dog"s + to_string(id % 10) + (id % 3 == 0 ? " fish"s : " hat"s)
+                          + (id % 7 == 0 ? " bird"s : ""s);
+        search_server.AddDocument(id, text, DocumentStatus::ACTUAL, {id % 5});
+    }
+    for (const string& raw_query : {"cat"s, "fish hat -bird"s, "dog* -dog3"s, "fsh~ hat~2"s, "-cat dog1"s}) {
+        TestQueryAllocations(search_server, raw_query, 1);
+    }
+}
+
+}  // namespace
+
+// Глобальные operator new/delete заменены только в программе проверок, чтобы TestQueryAllocations
+// видел все выделения из кучи
+void* operator new(size_t size) {
+    if (is_counting_allocations.load(std::memory_order_relaxed)) {
+        allocation_count.fetch_add(1, std::memory_order_relaxed);
+    }
+    if (void* p = std::malloc(size == 0 ? 1 : size)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void* p, size_t) noexcept {
+    std::free(p);
+}
+
+int main() {
+    RunSearchServerTests();
+    TestSequentialQueryAllocations();
+    cout << "Search server tests passed"s << endl;
+    return 0;
+}
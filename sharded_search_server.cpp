@@ -0,0 +1,74 @@
+#include "sharded_search_server.h"
+
+ShardedSearchServer::ShardedSearchServer(size_t shard_count, const std::string_view& stop_words_text)
+    : ShardedSearchServer(shard_count, SplitIntoWords(stop_words_text)) {
+}
+
+ShardedSearchServer::ShardedSearchServer(size_t shard_count, const std::string& stop_words_text)
+    : ShardedSearchServer(shard_count, SplitIntoWords(stop_words_text)) {
+}
+
+void ShardedSearchServer::AddDocument(int document_id, const std::string_view& document, DocumentStatus status,
+                                      const std::vector<int>& ratings) {
+    shards_[GetShardIndex(document_id)].AddDocument(document_id, document, status, ratings);
+}
+
+void ShardedSearchServer::RemoveDocument(int document_id) {
+    shards_[GetShardIndex(document_id)].RemoveDocument(document_id);
+}
+
+void ShardedSearchServer::UpdateDocumentStatus(int document_id, DocumentStatus status) {
+    shards_[GetShardIndex(document_id)].UpdateDocumentStatus(document_id, status);
+}
+
+void ShardedSearchServer::UpdateDocumentRating(int document_id, const std::vector<int>& ratings) {
+    shards_[GetShardIndex(document_id)].UpdateDocumentRating(document_id, ratings);
+}
+
+std::tuple<std::vector<std::string_view>, DocumentStatus> ShardedSearchServer::MatchDocument(
+    const std::string_view& raw_query,
+    int document_id) const {
+    return shards_[GetShardIndex(document_id)].MatchDocument(raw_query, document_id);
+}
+
+std::vector<Document> ShardedSearchServer::FindTopDocuments(const std::string_view& raw_query, DocumentStatus status) const {
+    return FindTopDocuments(raw_query, [status](int document_id, DocumentStatus document_status, int rating) {
+                                return document_status == status;
+                            });
+}
+
+std::vector<Document> ShardedSearchServer::FindTopDocuments(const std::string_view& raw_query) const {
+    return FindTopDocuments(raw_query, DocumentStatus::ACTUAL);
+}
+
+int ShardedSearchServer::GetDocumentCount() const {
+    int document_count = 0;
+    for (const SearchServer& shard : shards_) {
+        document_count += shard.GetDocumentCount();
+    }
+    return document_count;
+}
+
+size_t ShardedSearchServer::GetShardCount() const {
+    return shards_.size();
+}
+
+size_t ShardedSearchServer::GetShardIndex(int document_id) const {
+    return std::hash<int>{}(document_id) % shards_.size();
+}
+
+void ShardedSearchServer::MergeQueryExpansion(QueryExpansion& target, const QueryExpansion& source) {
+    target.document_count += source.document_count;
+    // Стоп-слова у шардов общие, поэтому слова запроса у всех шардов идут в одном порядке
+    if (target.words.empty()) {
+        target.words = source.words;
+        return;
+    }
+    for (size_t i = 0; i < source.words.size(); ++i) {
+        auto& terms = target.words[i].terms;
+        for (const auto& [term, match] : source.words[i].terms) {
+            auto& [distance, document_count] = terms.try_emplace(term, match.first, 0).first->second;
+            document_count += match.second;
+        }
+    }
+}
@@ -0,0 +1,97 @@
+#pragma once
+#include <execution>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <algorithm>
+#include <vector>
+#include "search_server.h"
+#include "document.h"
+
+// Разбивает документы по хешу id между несколькими экземплярами SearchServer.
+// Поиск выполняется на всех шардах параллельно по общей статистике коллекции,
+// поэтому релевантность совпадает с релевантностью в едином SearchServer
+class ShardedSearchServer {
+public:
+    template <typename StringContainer>
+    ShardedSearchServer(size_t shard_count, const StringContainer& stop_words);
+
+    ShardedSearchServer(size_t shard_count, const std::string_view& stop_words_text);
+
+    ShardedSearchServer(size_t shard_count, const std::string& stop_words_text);
+
+    void AddDocument(int document_id, const std::string_view& document, DocumentStatus status, const std::vector<int>& ratings);
+
+    void RemoveDocument(int document_id);
+
+    void UpdateDocumentStatus(int document_id, DocumentStatus status);
+
+    void UpdateDocumentRating(int document_id, const std::vector<int>& ratings);
+
+    std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(const std::string_view& raw_query, int document_id) const;
+
+    template <typename DocumentPredicate>
+    std::vector<Document> FindTopDocuments(const std::string_view& raw_query, DocumentPredicate document_predicate) const;
+
+    std::vector<Document> FindTopDocuments(const std::string_view& raw_query, DocumentStatus status) const;
+
+    std::vector<Document> FindTopDocuments(const std::string_view& raw_query) const;
+
+    int GetDocumentCount() const;
+
+    size_t GetShardCount() const;
+
+private:
+    std::vector<SearchServer> shards_;
+
+    size_t GetShardIndex(int document_id) const;
+
+    // Добавляет в target слова и документные частоты раскрытия одного шарда
+    static void MergeQueryExpansion(QueryExpansion& target, const QueryExpansion& source);
+};
+
+template <typename StringContainer>
+ShardedSearchServer::ShardedSearchServer(size_t shard_count, const StringContainer& stop_words) {
+    if (shard_count == 0) {
+        throw std::invalid_argument("Shard count must be positive");
+    }
+    shards_.reserve(shard_count);
+    for (size_t i = 0; i < shard_count; ++i) {
+        shards_.emplace_back(stop_words);
+    }
+}
+
+template <typename DocumentPredicate>
+std::vector<Document> ShardedSearchServer::FindTopDocuments(const std::string_view& raw_query,
+                                                            DocumentPredicate document_predicate) const {
+    // Раскрываем префиксы и опечатки по словарям всех шардов и собираем их документные частоты, чтобы
+    // набор слов и IDF были такими же, как в едином индексе
+    std::vector<QueryExpansion> shard_expansions(shards_.size());
+    std::transform(std::execution::par, shards_.begin(), shards_.end(), shard_expansions.begin(),
+                   [&raw_query](const SearchServer& shard) {
+                       QueryExpansion expansion;
+                       shard.CollectQueryExpansion(raw_query, expansion);
+                       return expansion;
+                   });
+    QueryExpansion expansion;
+    for (const QueryExpansion& shard_expansion : shard_expansions) {
+        MergeQueryExpansion(expansion, shard_expansion);
+    }
+
+    std::vector<std::vector<Document>> shard_documents(shards_.size());
+    std::transform(std::execution::par, shards_.begin(), shards_.end(), shard_documents.begin(),
+                   [&expansion, &document_predicate](const SearchServer& shard) {
+                       return shard.FindTopDocuments(std::execution::seq, expansion, document_predicate);
+                   });
+
+    // Лучшие документы коллекции содержатся среди лучших документов шардов
+    std::vector<Document> matched_documents;
+    for (const auto& documents : shard_documents) {
+        matched_documents.insert(matched_documents.end(), documents.begin(), documents.end());
+    }
+    SearchServer::SelectTopDocuments(matched_documents);
+
+    return matched_documents;
+}
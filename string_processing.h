@@ -1,11 +1,46 @@
 #pragma once
+#include <cstdint>
 #include <set>
 #include <string>
 #include <vector>
 #include <string_view>
 
+// Передаёт callback слова text по одному, не собирая их в контейнер. Слова разделены одиночными
+// пробелами: между соседними пробелами, а также в начале и в конце текста могут быть пустые слова
+template <typename Callback>
+void ForEachWord(const std::string_view& text, Callback callback) {
+    size_t pos = 0;
+    const size_t pos_end = text.npos;
+    while(true){
+        size_t space = text.find(' ', pos);
+        callback(text.substr(pos, space - pos));
+    
+    if (space == pos_end) {
+        break;
+    } else {
+        pos = space + 1;
+    }
+    }
+}
+
 std::vector<std::string_view> SplitIntoWords(const std::string_view& text);
 
+// Хеш строки из семейства хеш-функций: каждый seed задаёт свою функцию. Вычисляется и при компиляции
+constexpr uint64_t HashString(const std::string_view& text, uint64_t seed) {
+    // FNV-1a с перемешиванием seed и финализатором MurmurHash3 для равномерности младших битов
+    uint64_t hash = 14695981039346656037ULL ^ (seed * 0x9E3779B97F4A7C15ULL);
+    for (const char c : text) {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 1099511628211ULL;
+    }
+    hash ^= hash >> 33;
+    hash *= 0xFF51AFD7ED558CCDULL;
+    hash ^= hash >> 33;
+    hash *= 0xC4CEB9FE1A85EC53ULL;
+    hash ^= hash >> 33;
+    return hash;
+}
+
 template <typename StringContainer>
 std::set<std::string, std::less<>> MakeUniqueNonEmptyStrings(const StringContainer& strings) {
     std::set<std::string, std::less<>> non_empty_strings;
@@ -1,6 +1,85 @@
 #include "test_example_functions.h"
+#include <algorithm>
+#include <cmath>
+#include <csignal>
+#include <cstdio>
+#include <execution>
+#include <fstream>
+#include <iostream>
 #include <map>
+#include <optional>
+#include <set>
+#include <stdexcept>
 #include <string>
+#include <vector>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace {
+
+void CheckTest(bool condition, const std::string& message) {
+    if (!condition) {
+        throw std::logic_error(message);
+    }
+}
+
+bool AreSameDocuments(const std::vector<Document>& lhs, const std::vector<Document>& rhs) {
+    return std::equal(lhs.begin(), lhs.end(), rhs.begin(), rhs.end(), [](const Document& lhs, const Document& rhs) {
+        return lhs.id == rhs.id && lhs.rating == rhs.rating && std::abs(lhs.relevance - rhs.relevance) < EPSILON;
+    });
+}
+
+// Лучшие документы запроса, кроме уже выданных, повторными FindTopDocuments: эталон для постраничной выдачи
+std::vector<int> FindAllRankedIds(const SearchServer& search_server, const std::string& raw_query) {
+    std::vector<int> ids;
+    std::set<int> found_ids;
+    while (true) {
+        const auto documents = search_server.FindTopDocuments(raw_query,
+            [&found_ids](int document_id, DocumentStatus status, int rating) {
+                return status == DocumentStatus::ACTUAL && found_ids.count(document_id) == 0;
+            });
+        if (documents.empty()) {
+            return ids;
+        }
+        for (const Document& document : documents) {
+            ids.push_back(document.id);
+            found_ids.insert(document.id);
+        }
+    }
+}
+
+// Запросы с префиксами, опечатками и минус-словами по словам MakeTestSearchServer
+const std::vector<std::string> TEST_QUERIES = {
+    "dog"s, "fish hat"s, "dog fish hat -bird"s, "ca* -fish"s, "hat~ dog"s, "cat~1 -d*"s, "fsh~2 hat"s, "-cat dog"s,
+};
+
+// Документы с повторяющимися сочетаниями слов и рейтингов, чтобы в выдаче были равные релевантности
+std::string MakeTestDocument(int id) {
+    std::string text = "cat"s;
+    text += id % 2 == 0 ? " dog"s : " and bird"s;
+    text += id % 3 == 0 ? " fish"s : ""s;
+    text += id % 5 == 0 ? " cat"s : " hat"s;
+    return text;
+}
+
+DocumentStatus MakeTestStatus(int id) {
+    return id % 7 == 0 ? DocumentStatus::BANNED : DocumentStatus::ACTUAL;
+}
+
+template <typename Server>
+void AddTestDocuments(Server& search_server, int document_count) {
+    for (int id = 0; id < document_count; ++id) {
+        search_server.AddDocument(id, MakeTestDocument(id), MakeTestStatus(id), {id % 4});
+    }
+}
+
+SearchServer MakeTestSearchServer(int document_count) {
+    SearchServer search_server("and with"s);
+    AddTestDocuments(search_server, document_count);
+    return search_server;
+}
+
+}  // namespace
 
 const std::map<std::string_view, double>& TestGetWordFrequencies(SearchServer& search_server, int document_id) {
     LOG_DURATION("GetWordFrequencies ");
@@ -15,4 +94,313 @@ void TestRemoveDocument(SearchServer& search_server, int document_id) {
 void TestRemoveDuplicates(SearchServer& search_server) {
     LOG_DURATION("RemoveDuplicates ");
     RemoveDuplicates(search_server);
-}
\ No newline at end of file
+}
+
+void TestSearchCursorPaging() {
+    SearchServer search_server = MakeTestSearchServer(60);
+    const std::string raw_query = "dog fish hat -bird"s;
+
+    std::vector<int> paged_ids;
+    SearchCursor cursor = search_server.CreateSearchCursor(raw_query);
+    for (SearchPage page = search_server.FindTopDocumentsAfter(cursor); !page.documents.empty();
+         page = search_server.FindTopDocumentsAfter(page.next)) {
+        CheckTest(page.documents.size() <= MAX_RESULT_DOCUMENT_COUNT, "Search page is too long"s);
+        for (const Document& document : page.documents) {
+            paged_ids.push_back(document.id);
+        }
+    }
+    CheckTest(paged_ids == FindAllRankedIds(search_server, raw_query),
+              "Search pages differ from repeated FindTopDocuments"s);
+
+    // Новые документы меняют IDF слов запроса, но страницы после курсора продолжают прежний порядок
+    const SearchPage first_page = search_server.FindTopDocumentsAfter(cursor);
+    for (int id = 100; id < 140; ++id) {
+        search_server.AddDocument(id, "dog hat"s, DocumentStatus::ACTUAL, {id});
+    }
+    std::set<int> seen_ids;
+    for (const Document& document : first_page.documents) {
+        seen_ids.insert(document.id);
+    }
+    Document last_document = first_page.documents.back();
+    for (SearchPage page = search_server.FindTopDocumentsAfter(first_page.next); !page.documents.empty();
+         page = search_server.FindTopDocumentsAfter(page.next)) {
+        for (const Document& document : page.documents) {
+            CheckTest(seen_ids.insert(document.id).second, "Search pages repeat a document"s);
+            CheckTest(SearchServer::IsPagedBefore(last_document, document), "Search pages are out of order"s);
+            last_document = document;
+        }
+    }
+}
+
+void TestMinusPrefixExpansion() {
+    SearchServer search_server(""s);
+    // Слова word100 ... word199 идут по алфавиту в порядке id документов
+    for (int id = 0; id < 100; ++id) {
+        search_server.AddDocument(id, "cat word"s + std::to_string(100 + id), DocumentStatus::ACTUAL, {1});
+    }
+    const std::string raw_query = "cat -word*"s;
+    std::vector<int> found_ids;
+    for (SearchPage page = search_server.FindTopDocumentsAfter(search_server.CreateSearchCursor(raw_query));
+         !page.documents.empty(); page = search_server.FindTopDocumentsAfter(page.next)) {
+        for (const Document& document : page.documents) {
+            found_ids.push_back(document.id);
+        }
+    }
+    std::sort(found_ids.begin(), found_ids.end());
+    CheckTest(found_ids.size() == 100 - MAX_PREFIX_EXPANSION_COUNT && found_ids.front() == MAX_PREFIX_EXPANSION_COUNT,
+              "Minus prefix must exclude documents of the first MAX_PREFIX_EXPANSION_COUNT words only"s);
+    CheckTest(AreSameDocuments(search_server.FindTopDocumentsBatch({raw_query}).front(),
+                               search_server.FindTopDocuments(raw_query)),
+              "Batch search must expand minus prefixes the same way"s);
+}
+
+void TestCompletions() {
+    SearchServer search_server(""s);
+    std::map<std::string, int> document_counts;
+    int id = 0;
+    for (int word = 0; word < 40; ++word) {
+        const std::string long_word = "prefix"s + std::to_string(word);
+        const std::string short_word = "pr"s + std::to_string(word % 5);
+        for (int copy = 0; copy <= word % 9; ++copy) {
+            search_server.AddDocument(id++, long_word + " "s + short_word, DocumentStatus::ACTUAL, {1});
+            ++document_counts[long_word];
+            ++document_counts[short_word];
+        }
+    }
+    for (const std::string& prefix : {"p"s, "pr"s, "pre"s, "prefix"s, "prefix1"s, "prefix39"s, "x"s}) {
+        for (int max_count : {0, 1, 5, MAX_CACHED_COMPLETION_COUNT, MAX_CACHED_COMPLETION_COUNT + 1, 100}) {
+            std::vector<std::pair<int, std::string>> expected;
+            for (const auto& [word, count] : document_counts) {
+                if (word.substr(0, prefix.size()) == prefix) {
+                    expected.emplace_back(-count, word);
+                }
+            }
+            std::sort(expected.begin(), expected.end());
+            expected.resize(std::min<size_t>(expected.size(), max_count));
+            const auto completions = search_server.GetCompletions(prefix, max_count);
+            CheckTest(completions.size() == expected.size(), "Wrong number of completions for "s + prefix);
+            for (size_t i = 0; i < completions.size(); ++i) {
+                CheckTest(completions[i] == expected[i].second, "Wrong completion order for "s + prefix);
+            }
+        }
+    }
+}
+
+void TestSearchServerCopy() {
+    SearchServer search_server = MakeTestSearchServer(60);
+    search_server.SetHeadTermCacheSize(4);
+    const SearchServer copy = search_server;
+    CheckTest(copy.GetDocumentCount() == search_server.GetDocumentCount(), "Copy must keep every document"s);
+    for (const std::string& raw_query : TEST_QUERIES) {
+        CheckTest(AreSameDocuments(copy.FindTopDocuments(raw_query), search_server.FindTopDocuments(raw_query)),
+                  "Copy must find the same documents for "s + raw_query);
+    }
+    const auto expected = copy.FindTopDocuments("dog"s);
+    for (int id = 0; id < 60; id += 2) {
+        search_server.RemoveDocument(id);
+    }
+    CheckTest(AreSameDocuments(copy.FindTopDocuments("dog"s), expected), "Copy must not share the index"s);
+}
+
+void TestShardedSearch() {
+    const SearchServer search_server = MakeTestSearchServer(200);
+    for (size_t shard_count : {1, 3, 8}) {
+        ShardedSearchServer sharded_search_server(shard_count, "and with"s);
+        AddTestDocuments(sharded_search_server, 200);
+        for (const std::string& raw_query : TEST_QUERIES) {
+            for (const DocumentStatus status : {DocumentStatus::ACTUAL, DocumentStatus::BANNED}) {
+                const auto expected = search_server.FindTopDocuments(raw_query, status);
+                const auto documents = sharded_search_server.FindTopDocuments(raw_query, status);
+                CheckTest(AreSameDocuments(documents, expected),
+                          "Sharded search differs from a single server for "s + raw_query);
+            }
+        }
+    }
+}
+
+void TestMemoryStats() {
+    SearchServer search_server = MakeTestSearchServer(100);
+    const MemoryStats stats = search_server.GetMemoryStats();
+    CheckTest(stats.posting_bytes > 0 && stats.forward_index_bytes > 0 && stats.document_metadata_bytes > 0,
+              "Memory stats must count every index structure"s);
+    const size_t document_ids_bytes = (search_server.end() - search_server.begin()) * sizeof(int);
+    for (int id = 0; id < 100; ++id) {
+        search_server.RemoveDocument(id);
+    }
+    const MemoryStats empty_stats = search_server.GetMemoryStats();
+    CheckTest(empty_stats.posting_bytes == 0 && empty_stats.forward_index_bytes == 0,
+              "Memory stats must drop to zero after removing every document"s);
+    // Вектор id сохраняет ёмкость после удаления документов
+    CheckTest(empty_stats.document_metadata_bytes >= document_ids_bytes
+              && empty_stats.document_metadata_bytes < stats.document_metadata_bytes,
+              "Document metadata must be released with documents"s);
+}
+
+void TestWriteAheadLogRecovery() {
+    const std::string path_prefix = "/tmp/search_server_test_"s + std::to_string(::getpid());
+    const std::string checkpoint_path = path_prefix + "_checkpoint"s;
+    const std::string log_path = path_prefix + "_wal"s;
+    const SearchServer expected = MakeTestSearchServer(90);
+
+    // Каждый этап выполняет отдельный процесс, убитый сразу после Sync, без деструкторов
+    const auto run_killed = [](const auto& stage) {
+        const pid_t pid = ::fork();
+        if (pid == 0) {
+            stage();
+            std::raise(SIGKILL);
+        }
+        int status = 0;
+        ::waitpid(pid, &status, 0);
+        CheckTest(WIFSIGNALED(status) && WTERMSIG(status) == SIGKILL, "Test process must be killed"s);
+    };
+    const auto add_documents = [](SearchServer& search_server, WriteAheadLog& log, int first_id, int last_id) {
+        for (int id = first_id; id < last_id; ++id) {
+            log.LogAddDocument(id, MakeTestDocument(id), MakeTestStatus(id), {id % 4});
+            search_server.AddDocument(id, MakeTestDocument(id), MakeTestStatus(id), {id % 4});
+        }
+    };
+    std::remove(log_path.c_str());
+    run_killed([&] {
+        SearchServer search_server("and with"s);
+        WriteAheadLog log(log_path);
+        add_documents(search_server, log, 0, 30);
+        log.Checkpoint(search_server, checkpoint_path);
+        add_documents(search_server, log, 30, 60);
+        log.Sync();
+    });
+    // Повторно открытый журнал продолжает нумерацию после контрольной точки
+    run_killed([&] {
+        SearchServer search_server = RecoverSearchServer(checkpoint_path, log_path);
+        WriteAheadLog log(log_path);
+        bool is_rejected = false;
+        try {
+            log.LogAddDocument(1000, "cat\ndog"s, DocumentStatus::ACTUAL, {1});
+        } catch (const std::invalid_argument&) {
+            is_rejected = true;
+        }
+        CheckTest(is_rejected, "Document text with a line break must not be logged"s);
+        add_documents(search_server, log, 60, 90);
+        log.Sync();
+    });
+    // Оборванная при сбое последняя запись пропускается
+    std::ofstream(log_path, std::ios::app) << "91 17 12345 A 91 0 1 1 ca";
+
+    const SearchServer recovered = RecoverSearchServer(checkpoint_path, log_path);
+    std::remove(checkpoint_path.c_str());
+    std::remove(log_path.c_str());
+    CheckTest(recovered.GetDocumentCount() == expected.GetDocumentCount(), "Recovery must restore every document"s);
+    for (const std::string& raw_query : TEST_QUERIES) {
+        CheckTest(AreSameDocuments(recovered.FindTopDocuments(raw_query), expected.FindTopDocuments(raw_query)),
+                  "Recovered server must find the same documents for "s + raw_query);
+    }
+}
+
+void TestExecutionCalibration() {
+    SearchServer search_server = MakeTestSearchServer(200);
+    ExecutionCalibration always_parallel;
+    always_parallel.parallel_threshold_postings = 0;
+    always_parallel.postings_per_thread = 1;
+    always_parallel.parallel_threshold_words = 0;
+    for (const ExecutionCalibration& calibration : {search_server.CalibrateExecution(TEST_QUERIES), always_parallel}) {
+        CheckTest(calibration.postings_per_thread > 0, "Calibration must keep postings per thread positive"s);
+        search_server.SetExecutionCalibration(calibration);
+        for (const std::string& raw_query : TEST_QUERIES) {
+            CheckTest(AreSameDocuments(search_server.FindTopDocuments(auto_execution, raw_query),
+                                       search_server.FindTopDocuments(std::execution::seq, raw_query)),
+                      "Automatic execution must find the same documents for "s + raw_query);
+            const auto& [words, status] = search_server.MatchDocument(auto_execution, raw_query, 2);
+            const auto& [expected_words, expected_status] = search_server.MatchDocument(std::execution::seq, raw_query, 2);
+            CheckTest(words == expected_words && status == expected_status,
+                      "Automatic execution must match the same words for "s + raw_query);
+        }
+    }
+}
+
+void TestBatchSearch() {
+    SearchServer search_server = MakeTestSearchServer(300);
+    // Пачка длиннее BATCH_PART_QUERY_COUNT, чтобы запросы попали в разные части
+    std::vector<std::string_view> raw_queries;
+    while (raw_queries.size() <= BATCH_PART_QUERY_COUNT) {
+        raw_queries.insert(raw_queries.end(), TEST_QUERIES.begin(), TEST_QUERIES.end());
+    }
+    for (const double accuracy : {0.0, 1.0, 0.5}) {
+        QueryPruning query_pruning;
+        query_pruning.enabled = accuracy > 0.0;
+        query_pruning.accuracy = query_pruning.enabled ? accuracy : 1.0;
+        search_server.SetQueryPruning(query_pruning);
+        for (const DocumentStatus status : {DocumentStatus::ACTUAL, DocumentStatus::BANNED}) {
+            const auto results = search_server.FindTopDocumentsBatch(raw_queries, status);
+            CheckTest(results.size() == raw_queries.size(), "Batch search must answer every query"s);
+            for (size_t i = 0; i < raw_queries.size(); ++i) {
+                CheckTest(AreSameDocuments(results[i], search_server.FindTopDocuments(raw_queries[i], status)),
+                          "Batch search differs from FindTopDocuments for "s + std::string(raw_queries[i]));
+            }
+        }
+    }
+}
+
+void TestPerfectHashStopWords() {
+    std::optional<SearchServer> search_server;
+    {
+        // Строки слов и таблица уничтожаются раньше сервера
+        const std::vector<std::string> stop_words = {"and"s, "in"s, "with"s};
+        const auto table = MakePerfectHashTable(std::array<std::string_view, 3>{stop_words[0], stop_words[1], stop_words[2]});
+        search_server.emplace(table);
+    }
+    search_server->AddDocument(1, "cat and dog"s, DocumentStatus::ACTUAL, {1});
+    const SearchServer& original = *search_server;
+    const SearchServer copy(original);
+    const SearchServer renumbered = original.RenumberDocuments({1});
+    for (const SearchServer* server : {&original, &copy, &renumbered}) {
+        CheckTest(server->FindTopDocuments("and in"s).empty(), "Stop words must not be found"s);
+        CheckTest(server->FindTopDocuments("cat"s).size() == 1, "Words besides stop words must be found"s);
+    }
+}
+
+void TestDocumentReordering() {
+    const SearchServer search_server = MakeTestSearchServer(300);
+    const auto check_same_results = [&search_server](const ReorderedSearchServer& reordered) {
+        for (const std::string& raw_query : TEST_QUERIES) {
+            for (const DocumentStatus status : {DocumentStatus::ACTUAL, DocumentStatus::BANNED}) {
+                CheckTest(AreSameDocuments(reordered.FindTopDocuments(raw_query, status),
+                                           search_server.FindTopDocuments(raw_query, status)),
+                          "Reordered server must find the same documents for "s + raw_query);
+            }
+        }
+    };
+    check_same_results(ReorderedSearchServer(search_server));
+
+    // Контрольная точка с reorder_documents хранит порядок сходства, и восстановленный индекс
+    // перенумеровывается в нём без повторного вычисления
+    const std::string path_prefix = "/tmp/search_server_test_"s + std::to_string(::getpid());
+    const std::string checkpoint_path = path_prefix + "_reordered_checkpoint"s;
+    const std::string log_path = path_prefix + "_reordered_wal"s;
+    std::remove(log_path.c_str());
+    {
+        WriteAheadLogOptions options;
+        options.reorder_documents = true;
+        WriteAheadLog log(log_path, options);
+        log.Checkpoint(search_server, checkpoint_path);
+    }
+    const SearchServer recovered = RecoverSearchServer(checkpoint_path, log_path);
+    std::remove(checkpoint_path.c_str());
+    std::remove(log_path.c_str());
+    const std::vector<int> similarity_order = ComputeSimilarityOrder(search_server);
+    CheckTest(std::equal(recovered.begin(), recovered.end(), similarity_order.begin(), similarity_order.end()),
+              "Checkpoint must keep documents in similarity order"s);
+    check_same_results(ReorderedSearchServer(recovered, {recovered.begin(), recovered.end()}));
+}
+
+void RunSearchServerTests() {
+    TestSearchCursorPaging();
+    TestMinusPrefixExpansion();
+    TestCompletions();
+    TestSearchServerCopy();
+    TestShardedSearch();
+    TestMemoryStats();
+    TestWriteAheadLogRecovery();
+    TestExecutionCalibration();
+    TestBatchSearch();
+    TestPerfectHashStopWords();
+    TestDocumentReordering();
+}
@@ -1,5 +1,8 @@
 #pragma once
 #include "search_server.h"
+#include "sharded_search_server.h"
+#include "document_reordering.h"
+#include "write_ahead_log.h"
 #include "remove_duplicates.h"
 #include "log_duration.h"
 
@@ -7,4 +10,44 @@ const std::map<std::string_view, double>& TestGetWordFrequencies(SearchServer& s
 
 void TestRemoveDocument(SearchServer& search_server, int document_id);
 
-void TestRemoveDuplicates(SearchServer& search_server);
\ No newline at end of file
+void TestRemoveDuplicates(SearchServer& search_server);
+
+// Страницы курсора содержат каждый подходящий документ один раз в порядке выдачи, и добавление документов
+// между страницами не сдвигает позицию курсора
+void TestSearchCursorPaging();
+
+// Минус-слово с префиксом раскрывается не больше чем в MAX_PREFIX_EXPANSION_COUNT слов, как и плюс-слово
+void TestMinusPrefixExpansion();
+
+// Дополнения из кеша и из обхода слов префикса совпадают с полным перебором словаря
+void TestCompletions();
+
+// Копия сервера ищет так же, как исходный, и не зависит от его дальнейших изменений
+void TestSearchServerCopy();
+
+// Шардированный сервер находит те же документы с той же релевантностью, что и единый
+void TestShardedSearch();
+
+// Учёт памяти возвращается к нулю, когда удалены все документы
+void TestMemoryStats();
+
+// Документы, записанные в журнал процессом, убитым после Sync, восстанавливаются из контрольной точки
+// и журнала, в том числе записанные после контрольной точки и после повторного открытия журнала
+void TestWriteAheadLogRecovery();
+
+// auto_execution находит то же, что последовательный поиск, при любых порогах, в том числе подобранных
+// CalibrateExecution
+void TestExecutionCalibration();
+
+// Пачка запросов находит для каждого запроса то же, что FindTopDocuments, с отсечением слов и без него
+void TestBatchSearch();
+
+// Сервер со стоп-словами из таблицы MakePerfectHashTable и его копии работают после уничтожения таблицы
+void TestPerfectHashStopWords();
+
+// Перенумерованный индекс находит то же, что исходный, включая порядок документов с равной релевантностью,
+// в том числе после контрольной точки в порядке сходства
+void TestDocumentReordering();
+
+// Запускает все проверки; бросает std::logic_error при первой неудачной
+void RunSearchServerTests();
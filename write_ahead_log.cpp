@@ -0,0 +1,451 @@
+#include "write_ahead_log.h"
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <execution>
+#include <fcntl.h>
+#include <fstream>
+#include <iterator>
+#include <optional>
+#include <sstream>
+#include <system_error>
+#include <unistd.h>
+#include "document_reordering.h"
+
+namespace {
+
+enum class LogOperation {
+    ADD,
+    REMOVE,
+    UPDATE_STATUS,
+    UPDATE_RATING,
+    CHECKPOINT,
+};
+
+struct LogRecord {
+    uint64_t lsn = 0;
+    LogOperation operation = LogOperation::CHECKPOINT;
+    int document_id = 0;
+    DocumentStatus status = DocumentStatus::ACTUAL;
+    std::vector<int> ratings;
+    std::string document;
+};
+
+uint32_t ComputeCrc32(const std::string_view& data) {
+    static const auto table = [] {
+        std::array<uint32_t, 256> table{};
+        for (uint32_t i = 0; i < table.size(); ++i) {
+            uint32_t value = i;
+            for (int bit = 0; bit < 8; ++bit) {
+                value = (value & 1) != 0 ? (value >> 1) ^ 0xEDB88320u : value >> 1;
+            }
+            table[i] = value;
+        }
+        return table;
+    }();
+    uint32_t crc = 0xFFFFFFFFu;
+    for (const char c : data) {
+        crc = table[(crc ^ static_cast<unsigned char>(c)) & 0xFF] ^ (crc >> 8);
+    }
+    return crc ^ 0xFFFFFFFFu;
+}
+
+// Контрольная сумма покрывает и номер записи, и её содержимое
+uint32_t ComputeRecordChecksum(uint64_t lsn, const std::string_view& payload) {
+    std::string data = std::to_string(lsn);
+    data += ' ';
+    data += payload;
+    return ComputeCrc32(data);
+}
+
+std::string FormatLogRecord(uint64_t lsn, const std::string& payload) {
+    return std::to_string(lsn) + ' ' + std::to_string(payload.size()) + ' '
+         + std::to_string(ComputeRecordChecksum(lsn, payload)) + ' ' + payload + '\n';
+}
+
+// Формат строки журнала: <lsn> <длина записи> <crc32> <запись>, где запись — одна из
+//   A <id> <status> <число оценок> <оценки...> <текст>
+//   R <id>
+//   S <id> <status>
+//   G <id> <число оценок> <оценки...>
+//   C                — отметка усечения журнала после контрольной точки
+// Длина и контрольная сумма позволяют отличить оборванную при сбое запись от целой.
+// Текст документа не может содержать перевода строки: LogAddDocument такой текст не записывает
+std::optional<LogRecord> ParseLogRecord(const std::string& line) {
+    std::istringstream header(line);
+    LogRecord record;
+    size_t payload_size = 0;
+    uint32_t checksum = 0;
+    if (!(header >> record.lsn >> payload_size >> checksum) || header.get() != ' ') {
+        return std::nullopt;
+    }
+    const size_t payload_begin = static_cast<size_t>(header.tellg());
+    if (line.size() - payload_begin != payload_size
+        || ComputeRecordChecksum(record.lsn, std::string_view(line).substr(payload_begin)) != checksum) {
+        return std::nullopt;
+    }
+
+    std::istringstream input(line.substr(payload_begin));
+    char operation = 0;
+    if (!(input >> operation)) {
+        return std::nullopt;
+    }
+    if (operation == 'C') {
+        record.operation = LogOperation::CHECKPOINT;
+        return record;
+    }
+    if (!(input >> record.document_id)) {
+        return std::nullopt;
+    }
+    if (operation == 'R') {
+        record.operation = LogOperation::REMOVE;
+        return record;
+    }
+    if (operation == 'S') {
+        record.operation = LogOperation::UPDATE_STATUS;
+        int status = 0;
+        if (!(input >> status)) {
+            return std::nullopt;
+        }
+        record.status = static_cast<DocumentStatus>(status);
+        return record;
+    }
+    if (operation == 'G') {
+        record.operation = LogOperation::UPDATE_RATING;
+        size_t ratings_count = 0;
+        if (!(input >> ratings_count)) {
+            return std::nullopt;
+        }
+        record.ratings.resize(ratings_count);
+        for (int& rating : record.ratings) {
+            input >> rating;
+        }
+        return input ? std::optional(record) : std::nullopt;
+    }
+    if (operation != 'A') {
+        return std::nullopt;
+    }
+
+    record.operation = LogOperation::ADD;
+    int status = 0;
+    size_t ratings_count = 0;
+    if (!(input >> status >> ratings_count)) {
+        return std::nullopt;
+    }
+    record.status = static_cast<DocumentStatus>(status);
+    record.ratings.resize(ratings_count);
+    for (int& rating : record.ratings) {
+        input >> rating;
+    }
+    // После оценок стоит ровно один пробел, дальше текст документа как есть
+    if (!input || input.get() != ' ') {
+        return std::nullopt;
+    }
+    std::getline(input, record.document);
+    return record;
+}
+
+// Строки журнала, завершённые переводом строки. Хвост без перевода строки — запись, оборванная при сбое;
+// complete_size — размер файла без него
+std::vector<std::string> ReadLogLines(const std::string& path, size_t& complete_size) {
+    std::ifstream input(path, std::ios::binary);
+    const std::string content{std::istreambuf_iterator<char>(input), std::istreambuf_iterator<char>()};
+    std::vector<std::string> lines;
+    complete_size = 0;
+    for (size_t line_end; (line_end = content.find('\n', complete_size)) != std::string::npos;
+         complete_size = line_end + 1) {
+        lines.push_back(content.substr(complete_size, line_end - complete_size));
+    }
+    return lines;
+}
+
+void WriteAll(int file_descriptor, const std::string& data) {
+    size_t written = 0;
+    while (written < data.size()) {
+        const ssize_t result = ::write(file_descriptor, data.data() + written, data.size() - written);
+        if (result < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw std::system_error(errno, std::generic_category(), "Write-ahead log write failed");
+        }
+        written += result;
+    }
+}
+
+void SyncFile(int file_descriptor) {
+    if (::fsync(file_descriptor) != 0) {
+        throw std::system_error(errno, std::generic_category(), "Write-ahead log fsync failed");
+    }
+}
+
+// Пишет файл во временный, сбрасывает на диск и атомарно подменяет им path
+void WriteFileDurably(const std::string& path, const std::string& data) {
+    const std::string temporary_path = path + ".tmp";
+    const int file_descriptor = ::open(temporary_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (file_descriptor < 0) {
+        throw std::system_error(errno, std::generic_category(), "Cannot create " + temporary_path);
+    }
+    try {
+        WriteAll(file_descriptor, data);
+        SyncFile(file_descriptor);
+    } catch (...) {
+        ::close(file_descriptor);
+        throw;
+    }
+    ::close(file_descriptor);
+    if (::rename(temporary_path.c_str(), path.c_str()) != 0) {
+        throw std::system_error(errno, std::generic_category(), "Cannot replace " + path);
+    }
+    // Переименование сохраняется на диске вместе с каталогом
+    const size_t separator_pos = path.rfind('/');
+    const std::string directory = separator_pos == std::string::npos ? "." : path.substr(0, separator_pos + 1);
+    const int directory_descriptor = ::open(directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (directory_descriptor < 0) {
+        throw std::system_error(errno, std::generic_category(), "Cannot open directory of " + path);
+    }
+    const int sync_result = ::fsync(directory_descriptor);
+    const int sync_error = errno;
+    ::close(directory_descriptor);
+    if (sync_result != 0) {
+        throw std::system_error(sync_error, std::generic_category(), "Cannot sync directory of " + path);
+    }
+}
+
+int OpenLogFile(const std::string& path) {
+    const int file_descriptor = ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (file_descriptor < 0) {
+        throw std::system_error(errno, std::generic_category(), "Cannot open write-ahead log " + path);
+    }
+    return file_descriptor;
+}
+
+}
+
+WriteAheadLog::WriteAheadLog(const std::string& path, WriteAheadLogOptions options)
+    : options_(options)
+    , path_(path) {
+    // Продолжаем нумерацию записей уже существующего журнала
+    size_t valid_size = 0;
+    std::vector<std::string> lines = ReadLogLines(path, valid_size);
+    for (size_t i = 0; i < lines.size(); ++i) {
+        if (const auto record = ParseLogRecord(lines[i])) {
+            last_lsn_ = std::max(last_lsn_, record->lsn);
+        } else if (i + 1 == lines.size()) {
+            valid_size -= lines[i].size() + 1;
+        }
+    }
+    synced_lsn_ = last_lsn_;
+
+    file_descriptor_ = OpenLogFile(path);
+    // Оборванную последнюю запись отрезаем, иначе новая запись склеилась бы с ней в одну испорченную строку
+    if (::ftruncate(file_descriptor_, static_cast<off_t>(valid_size)) != 0) {
+        const int error = errno;
+        ::close(file_descriptor_);
+        throw std::system_error(error, std::generic_category(), "Cannot truncate write-ahead log " + path);
+    }
+    writer_ = std::thread([this] {
+        RunWriter();
+    });
+}
+
+WriteAheadLog::~WriteAheadLog() {
+    {
+        std::lock_guard guard(mutex_);
+        stopping_ = true;
+    }
+    has_work_.notify_one();
+    writer_.join();
+    ::close(file_descriptor_);
+}
+
+uint64_t WriteAheadLog::LogAddDocument(int document_id, const std::string_view& document, DocumentStatus status,
+                                       const std::vector<int>& ratings) {
+    // Перевод строки разорвал бы запись, и журнал перестал бы читаться с этого места
+    if (document.find('\n') != std::string_view::npos) {
+        throw std::invalid_argument("Document text must not contain line breaks");
+    }
+    std::string record = "A " + std::to_string(document_id) + ' ' + std::to_string(static_cast<int>(status))
+                       + ' ' + std::to_string(ratings.size());
+    for (const int rating : ratings) {
+        record += ' ' + std::to_string(rating);
+    }
+    record += ' ';
+    record += document;
+    return Append(std::move(record));
+}
+
+uint64_t WriteAheadLog::LogRemoveDocument(int document_id) {
+    return Append("R " + std::to_string(document_id));
+}
+
+uint64_t WriteAheadLog::LogUpdateDocumentStatus(int document_id, DocumentStatus status) {
+    return Append("S " + std::to_string(document_id) + ' ' + std::to_string(static_cast<int>(status)));
+}
+
+uint64_t WriteAheadLog::LogUpdateDocumentRating(int document_id, const std::vector<int>& ratings) {
+    std::string record = "G " + std::to_string(document_id) + ' ' + std::to_string(ratings.size());
+    for (const int rating : ratings) {
+        record += ' ' + std::to_string(rating);
+    }
+    return Append(std::move(record));
+}
+
+void WriteAheadLog::Sync() {
+    std::unique_lock lock(mutex_);
+    const uint64_t target_lsn = last_lsn_;
+    sync_requested_ = true;
+    has_work_.notify_one();
+    synced_.wait(lock, [this, target_lsn] {
+        return synced_lsn_ >= target_lsn || writer_error_;
+    });
+    if (writer_error_) {
+        std::rethrow_exception(writer_error_);
+    }
+}
+
+void WriteAheadLog::Checkpoint(const SearchServer& search_server, const std::string& checkpoint_path) {
+    Sync();
+    uint64_t checkpoint_lsn = 0;
+    {
+        std::lock_guard guard(mutex_);
+        checkpoint_lsn = last_lsn_;
+    }
+
+    std::ostringstream checkpoint;
+    checkpoint << checkpoint_lsn << '\n';
+    if (options_.reorder_documents) {
+        search_server.SaveCheckpoint(checkpoint, ComputeSimilarityOrder(search_server));
+    } else {
+        search_server.SaveCheckpoint(checkpoint);
+    }
+    WriteFileDurably(checkpoint_path, checkpoint.str());
+
+    // Усекаем журнал, только если после контрольной точки в него не добавили ни одной записи.
+    // Проверяется last_lsn_, а не synced_lsn_: поток записи мог уже сбросить на диск новую пачку,
+    // но ещё не обновить synced_lsn_
+    std::lock_guard file_guard(file_mutex_);
+    std::lock_guard guard(mutex_);
+    if (last_lsn_ != checkpoint_lsn) {
+        return;
+    }
+    // Новый журнал из одной отметки подменяет старый целиком: при сбое на любом шаге на диске остаётся
+    // либо старый журнал, либо отметка, которая сохраняет нумерацию записей после контрольной точки
+    WriteFileDurably(path_, FormatLogRecord(checkpoint_lsn, "C"));
+    const int file_descriptor = OpenLogFile(path_);
+    ::close(file_descriptor_);
+    file_descriptor_ = file_descriptor;
+}
+
+uint64_t WriteAheadLog::Append(std::string record) {
+    std::unique_lock lock(mutex_);
+    ThrowIfFailed();
+    const uint64_t lsn = ++last_lsn_;
+    pending_records_.push_back(FormatLogRecord(lsn, record));
+    const bool is_batch_full = pending_records_.size() >= options_.sync_batch_size;
+    lock.unlock();
+    if (is_batch_full) {
+        has_work_.notify_one();
+    }
+    return lsn;
+}
+
+void WriteAheadLog::RunWriter() {
+    std::vector<std::string> batch;
+    std::unique_lock lock(mutex_);
+    while (true) {
+        // Пачка уходит на диск, когда набралось sync_batch_size записей, кто-то ждёт в Sync
+        // или прошло sync_interval с предыдущей пачки
+        has_work_.wait_for(lock, options_.sync_interval, [this] {
+            return stopping_ || sync_requested_ || pending_records_.size() >= options_.sync_batch_size;
+        });
+
+        batch.swap(pending_records_);
+        const uint64_t batch_lsn = last_lsn_;
+        const bool is_stopping = stopping_;
+        sync_requested_ = false;
+        lock.unlock();
+
+        try {
+            if (!batch.empty()) {
+                std::lock_guard file_guard(file_mutex_);
+                std::string data;
+                for (const std::string& record : batch) {
+                    data += record;
+                }
+                WriteAll(file_descriptor_, data);
+                SyncFile(file_descriptor_);
+            }
+        } catch (...) {
+            lock.lock();
+            writer_error_ = std::current_exception();
+            synced_.notify_all();
+            return;
+        }
+        batch.clear();
+
+        lock.lock();
+        synced_lsn_ = batch_lsn;
+        synced_.notify_all();
+        if (is_stopping && pending_records_.empty()) {
+            return;
+        }
+    }
+}
+
+void WriteAheadLog::ThrowIfFailed() {
+    if (writer_error_) {
+        std::rethrow_exception(writer_error_);
+    }
+}
+
+SearchServer RecoverSearchServer(const std::string& checkpoint_path, const std::string& log_path) {
+    std::ifstream checkpoint(checkpoint_path);
+    uint64_t checkpoint_lsn = 0;
+    if (!(checkpoint >> checkpoint_lsn)) {
+        throw std::invalid_argument("Cannot read checkpoint " + checkpoint_path);
+    }
+    SearchServer search_server = SearchServer::LoadCheckpoint(checkpoint);
+
+    size_t complete_size = 0;
+    const std::vector<std::string> lines = ReadLogLines(log_path, complete_size);
+
+    // Разбор записей независим и выполняется параллельно; применяются они строго в порядке журнала
+    std::vector<std::optional<LogRecord>> records(lines.size());
+    std::transform(std::execution::par, lines.begin(), lines.end(), records.begin(), ParseLogRecord);
+
+    for (size_t i = 0; i < records.size(); ++i) {
+        if (!records[i]) {
+            if (i + 1 == records.size()) {
+                break;
+            }
+            throw std::invalid_argument("Corrupted write-ahead log record: " + lines[i]);
+        }
+        const LogRecord& record = *records[i];
+        if (record.lsn <= checkpoint_lsn) {
+            continue;
+        }
+        // Запись журнала делается до изменения индекса. Если исходная операция была отвергнута
+        // (недопустимый документ или неизвестный id), повтор тоже ничего не меняет, и запись пропускается
+        try {
+            switch (record.operation) {
+                case LogOperation::ADD:
+                    search_server.AddDocument(record.document_id, record.document, record.status, record.ratings);
+                    break;
+                case LogOperation::REMOVE:
+                    search_server.RemoveDocument(record.document_id);
+                    break;
+                case LogOperation::UPDATE_STATUS:
+                    search_server.UpdateDocumentStatus(record.document_id, record.status);
+                    break;
+                case LogOperation::UPDATE_RATING:
+                    search_server.UpdateDocumentRating(record.document_id, record.ratings);
+                    break;
+                case LogOperation::CHECKPOINT:
+                    break;
+            }
+        } catch (const std::logic_error&) {
+        }
+    }
+    return search_server;
+}
@@ -0,0 +1,80 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include "search_server.h"
+#include "document.h"
+
+struct WriteAheadLogOptions {
+    size_t sync_batch_size = 256;                // число записей, после которого журнал сбрасывается на диск
+    std::chrono::milliseconds sync_interval{10}; // наибольшая задержка сброса на диск
+    // Контрольная точка пишет документы в порядке сходства ComputeSimilarityOrder, а не в порядке добавления
+    bool reorder_documents = false;
+};
+
+// Журнал упреждающей записи изменений индекса. Записи копятся в очереди и пишутся на диск пачками
+// отдельным потоком, поэтому Log* не ждут диска. Каждой записи присваивается номер (LSN).
+// Контрольная точка сохраняет весь индекс и номер последней вошедшей в неё записи, после чего журнал усекается
+class WriteAheadLog {
+public:
+    explicit WriteAheadLog(const std::string& path, WriteAheadLogOptions options = {});
+
+    WriteAheadLog(const WriteAheadLog&) = delete;
+    WriteAheadLog& operator=(const WriteAheadLog&) = delete;
+
+    ~WriteAheadLog();
+
+    // Текст с переводом строки не записывается: бросается std::invalid_argument
+    uint64_t LogAddDocument(int document_id, const std::string_view& document, DocumentStatus status,
+                            const std::vector<int>& ratings);
+
+    uint64_t LogRemoveDocument(int document_id);
+
+    uint64_t LogUpdateDocumentStatus(int document_id, DocumentStatus status);
+
+    uint64_t LogUpdateDocumentRating(int document_id, const std::vector<int>& ratings);
+
+    // Ждёт, пока все записанные в журнал изменения окажутся на диске
+    void Sync();
+
+    // Сохраняет контрольную точку search_server и заменяет журнал отметкой с её номером. Вызывается из потока,
+    // который изменяет search_server, после применения всех залогированных изменений
+    void Checkpoint(const SearchServer& search_server, const std::string& checkpoint_path);
+
+private:
+    WriteAheadLogOptions options_;
+    std::string path_;
+    int file_descriptor_ = -1;
+
+    std::mutex mutex_;
+    std::condition_variable has_work_;
+    std::condition_variable synced_;
+    std::vector<std::string> pending_records_;
+    uint64_t last_lsn_ = 0;
+    uint64_t synced_lsn_ = 0;
+    bool sync_requested_ = false;
+    bool stopping_ = false;
+    std::exception_ptr writer_error_;
+
+    // Захватывается на время записи в файл журнала
+    std::mutex file_mutex_;
+    std::thread writer_;
+
+    uint64_t Append(std::string record);
+
+    void RunWriter();
+
+    void ThrowIfFailed();
+};
+
+// Загружает последнюю контрольную точку и применяет записи журнала, сделанные после неё. Порядок документов
+// (GetDocumentId) — порядок контрольной точки, за которым идут документы из журнала.
+// Последняя запись без перевода строки или с неверной длиной либо контрольной суммой (обрыв при сбое)
+// пропускается; испорченная запись в середине журнала — ошибка std::invalid_argument
+SearchServer RecoverSearchServer(const std::string& checkpoint_path, const std::string& log_path);